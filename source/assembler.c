@@ -1,100 +1,112 @@
 #include "assembler.h"
+#include "peephole.h"
 
 #include <stdlib.h>
 
-void sakuraV_visitUnary(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
-    LOG_CALL();
-
-    // visit the operand
-    sakuraV_visitNode(S, assembly, node->left);
-
+void sakuraX_emitUnary(struct SakuraAssembly *assembly, enum TokenType op, int reg) {
     // determine the specific unary operation
-    if (node->token->type == SAKURA_TOKEN_MINUS) {
+    if (op == SAKURA_TOKEN_MINUS) {
         // negate the value, storing it back in it's original register
-        SakuraAssembly_push3(assembly, SAKURA_UNM, node->leftLocation, node->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_UNM, reg, reg, 0);
+    } else if (op == SAKURA_TOKEN_BANG) {
+        // invert the value, storing it back in it's original register
+        SakuraAssembly_pushABC(assembly, SAKURA_NOT, reg, reg, 0);
+    } else if (op == SAKURA_TOKEN_HASHTAG) {
+        // length of the table, storing it back in it's original register
+        SakuraAssembly_pushABC(assembly, SAKURA_LENTBL, reg, reg, 0);
     }
     // TODO: add more cases as needed
     // ignore '+' case as it does not affect the value
-
-    LOG_POP();
 }
 
-void sakuraV_visitBinary(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
-    LOG_CALL();
-
-    // visit the operands, swapped order is so the less than/greater than system works properly
-    if (node->token->type == SAKURA_TOKEN_GREATER || node->token->type == SAKURA_TOKEN_GREATER_EQUAL) {
-        sakuraV_visitNode(S, assembly, node->right);
-        sakuraV_visitNode(S, assembly, node->left);
-    } else {
-        sakuraV_visitNode(S, assembly, node->left);
-        sakuraV_visitNode(S, assembly, node->right);
-    }
-
-    assembly->registers -= 2;
-
-    node->leftLocation = assembly->registers++;
-
+int sakuraX_emitBinary(struct SakuraAssembly *assembly, enum TokenType op, int dest, int left, int right) {
     // determine the specific binary operation
-    switch (node->token->type) {
+    switch (op) {
     case SAKURA_TOKEN_PLUS:
         // add the values, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_ADD, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_ADD, dest, left, right);
         break;
     case SAKURA_TOKEN_MINUS:
         // subtract the values, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_SUB, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_SUB, dest, left, right);
         break;
     case SAKURA_TOKEN_STAR:
         // multiply the values, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_MUL, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_MUL, dest, left, right);
         break;
     case SAKURA_TOKEN_SLASH:
         // divide the values, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_DIV, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_DIV, dest, left, right);
         break;
     case SAKURA_TOKEN_CARET:
         // power the values, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_POW, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_POW, dest, left, right);
         break;
     case SAKURA_TOKEN_PERCENT:
         // mod the values, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_MOD, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_MOD, dest, left, right);
         break;
     case SAKURA_TOKEN_EQUAL_EQUAL:
         // check if the values are equal, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_EQ, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_EQ, dest, left, right);
         break;
     case SAKURA_TOKEN_BANG_EQUAL:
         // check if the values are not equal, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_EQ, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_EQ, dest, left, right);
         // invert the result, storing it in the left register
-        SakuraAssembly_push3(assembly, SAKURA_NOT, node->leftLocation, node->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_NOT, dest, dest, 0);
         break;
     case SAKURA_TOKEN_LESS:
-    case SAKURA_TOKEN_GREATER:
         // check if the left value is less than the right value, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_LT, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_LT, dest, left, right);
+        break;
+    case SAKURA_TOKEN_GREATER:
+        // a > b is b < a, so the operands are swapped
+        SakuraAssembly_pushABC(assembly, SAKURA_LT, dest, right, left);
         break;
     case SAKURA_TOKEN_LESS_EQUAL:
-    case SAKURA_TOKEN_GREATER_EQUAL:
         // check if the left value is less than or equal to the right value, storing the result in the left register
-        SakuraAssembly_push4(assembly, SAKURA_LE, node->leftLocation, node->left->leftLocation,
-                             node->right->leftLocation);
+        SakuraAssembly_pushABC(assembly, SAKURA_LE, dest, left, right);
         break;
-    default:
-        printf("Error: unknown binary operation '%d' in node '%d' ('%.*s' = ?)\n", node->token->type, node->type,
-               (int)node->token->length, node->token->start);
+    case SAKURA_TOKEN_GREATER_EQUAL:
+        // a >= b is b <= a, so the operands are swapped
+        SakuraAssembly_pushABC(assembly, SAKURA_LE, dest, right, left);
         break;
+    default:
+        return 0;
+    }
+
+    return 1;
+}
+
+void sakuraV_visitUnary(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
+    LOG_CALL();
+
+    // visit the operand
+    sakuraV_visitNode(S, assembly, node->left);
+
+    // the result stays in the operand's register
+    node->leftLocation = node->left->leftLocation;
+    sakuraX_emitUnary(assembly, node->token.type, node->leftLocation);
+
+    LOG_POP();
+}
+
+void sakuraV_visitBinary(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
+    LOG_CALL();
+
+    // visit the operands
+    sakuraV_visitNode(S, assembly, node->left);
+    sakuraV_visitNode(S, assembly, node->right);
+
+    assembly->registers -= 2;
+
+    node->leftLocation = assembly->registers++;
+
+    if (!sakuraX_emitBinary(assembly, node->token.type, node->leftLocation, node->left->leftLocation,
+                            node->right->leftLocation)) {
+        printf("Error: unknown binary operation '%d' in node '%d' ('%.*s' = ?)\n", node->token.type, node->type,
+               (int)node->token.length, node->token.start);
     }
 
     LOG_POP();
@@ -109,11 +121,11 @@ void sakuraV_visitNumber(SakuraState *S, struct SakuraAssembly *assembly, struct
     LOG_CALL();
 
     // store the value in the constant pool
-    index = sakuraX_pushKNumber(assembly, node->storageValue);
+    index = sakuraX_pushKLiteral(assembly, &node->storageValue);
     // load the value into the stack
     reg = assembly->registers++;
 
-    SakuraAssembly_push3(assembly, SAKURA_LOADK, reg, index);
+    SakuraAssembly_pushABx(assembly, SAKURA_LOADK, reg, index);
     // store the register location in the node
     node->leftLocation = reg;
 
@@ -134,12 +146,12 @@ void sakuraV_visitString(SakuraState *S, struct SakuraAssembly *assembly, struct
     LOG_CALL();
 
     // store the value in the constant pool
-    val.str = (char *)node->token->start;
-    val.len = node->token->length;
+    val.str = (char *)node->token.start;
+    val.len = node->token.length;
     index = sakuraX_pushKString(assembly, &val);
     // load the value into the stack
     reg = assembly->registers++;
-    SakuraAssembly_push3(assembly, SAKURA_LOADK, reg, index);
+    SakuraAssembly_pushABx(assembly, SAKURA_LOADK, reg, index);
     // store the register location in the node
     node->leftLocation = reg;
 
@@ -158,73 +170,85 @@ void sakuraV_visitIdentifier(SakuraState *S, struct SakuraAssembly *assembly, st
     LOG_CALL();
 
     // get the variable name as an s_str
-    name.str = (char *)node->token->start;
-    name.len = node->token->length;
+    name.str = (char *)node->token.start;
+    name.len = node->token.length;
 
-    // get the variable from the globals table
-    idx = sakuraX_TVMapGetIndex(&S->globals, &name);
+    // load the value into the next register
+    reg = assembly->registers++;
 
-    // check if the variable exists
+    // check the locals table first (user created variable), locals shadow globals
+    idx = sakuraY_findLocal(S, &name);
     if (idx != -1) {
-        // load the value into the next register
-        reg = assembly->registers++;
-        SakuraAssembly_push3(assembly, SAKURA_GETGLOBAL, reg, idx);
-        // store the register location in the node
-        node->leftLocation = reg;
-
-        if (reg >= assembly->highestRegister) {
-            assembly->highestRegister = reg;
-        }
+        SakuraAssembly_pushABC(assembly, SAKURA_MOVE, reg, idx, 0);
     } else {
-        // check the locals table (user created variable)
-        for (ull i = 0; i < S->localsSize; i++) {
-            if (s_str_cmp(&name, &S->locals[i]) == 0) {
-                // load the value into the next register
-                reg = assembly->registers++;
-                SakuraAssembly_push3(assembly, SAKURA_MOVE, reg, i);
-                // store the register location in the node
-                node->leftLocation = reg;
-
-                if (reg >= assembly->highestRegister) {
-                    assembly->highestRegister = reg;
-                }
+        // get the variable from the globals table
+        idx = sakuraX_TVMapGetIndex(&S->globals, &name);
 
-                LOG_POP();
-                return;
-            }
+        if (idx != -1) {
+            SakuraAssembly_pushABx(assembly, SAKURA_GETGLOBAL, reg, idx);
+        } else {
+            printf("Error: unknown variable '%.*s'\n", name.len, name.str);
+            SakuraAssembly_pushABC(assembly, SAKURA_LOADNIL, reg, 0, 0);
         }
     }
 
+    // store the register location in the node
+    node->leftLocation = reg;
+
+    if (reg >= assembly->highestRegister) {
+        assembly->highestRegister = reg;
+    }
+
     LOG_POP();
 }
 
 void sakuraV_visitFunction(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
     struct SakuraAssembly *funcAssembly;
+    struct SakuraSymbolTable outerLocals;
     struct s_str v;
     ull reg;
-    int idx;
+    int slot;
 
     LOG_CALL();
 
     // create a new assembly for the function
-    funcAssembly = SakuraAssembly();
+    funcAssembly = SakuraAssembly_new(assembly->pool);
+
+    // register the function name before the body so it can call itself, the slot of the global never changes
+    v.str = (char *)node->token.start;
+    v.len = node->token.length;
+    slot = sakuraX_TVMapInsert(&S->globals, &v, sakuraY_makeTFunc(funcAssembly));
+
+    // the function runs in its own register window, parameters take the first registers
+    sakuraY_enterLocals(S, &outerLocals);
+    for (ull i = 0; i < node->argCount; i++) {
+        struct s_str param;
+        param.str = (char *)node->args[i]->token.start;
+        param.len = node->args[i]->token.length;
+        sakuraY_storeLocal(S, &param, i);
+    }
+
+    funcAssembly->parameters = node->argCount;
+    funcAssembly->localCount = node->argCount;
+    funcAssembly->registers = node->argCount;
+    if (node->argCount > 0)
+        funcAssembly->highestRegister = node->argCount - 1;
 
     // visit the function body
     sakuraV_visitNode(S, funcAssembly, node->left);
 
     // bytecode to return from the function
-    SakuraAssembly_push3(funcAssembly, SAKURA_RETURN, 0, 0);
+    SakuraAssembly_pushABC(funcAssembly, SAKURA_RETURN, 0, 0, 0);
+    sakuraX_widenJumps(funcAssembly);
+
+    sakuraY_leaveLocals(S, &outerLocals);
 
     // create a closure from the function
     reg = assembly->registers++;
-    SakuraAssembly_push3(assembly, SAKURA_CLOSURE, reg, assembly->closureIdx);
+    SakuraAssembly_pushABx(assembly, SAKURA_CLOSURE, reg, assembly->closureIdx);
 
     // bytecode to set the function name
-    v.str = (char *)node->token->start;
-    v.len = node->token->length;
-    idx = sakuraX_pushKString(assembly, &v);
-    SakuraAssembly_push3(assembly, SAKURA_SETGLOBAL, reg, idx);
-    sakuraX_TVMapInsert(&S->globals, &v, sakuraY_makeTFunc(funcAssembly));
+    SakuraAssembly_pushABx(assembly, SAKURA_SETGLOBAL, reg, slot);
     assembly->registers--;
 
     // store the register location in the node
@@ -236,12 +260,16 @@ void sakuraV_visitFunction(SakuraState *S, struct SakuraAssembly *assembly, stru
 
     SakuraAssembly_pushChildAssembly(assembly, funcAssembly);
 
-    sakuraY_mergePoolsA(&assembly->pool, &funcAssembly->pool);
-
     LOG_POP();
 }
 
 void sakuraV_visitCall(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
+    LOG_CALL();
+    sakuraV_visitCallA(S, assembly, node, 0);
+    LOG_POP();
+}
+
+void sakuraV_visitCallA(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node, int tail) {
     struct s_str name;
     TValue *func;
     int idx;
@@ -251,90 +279,75 @@ void sakuraV_visitCall(SakuraState *S, struct SakuraAssembly *assembly, struct N
 
     if (node->left->type == SAKURA_TOKEN_IDENTIFIER) {
         // get the function name as an s_str
-        name.str = (char *)node->left->token->start;
-        name.len = node->left->token->length;
-
-        // get the function from the global table
-        func = sakuraX_TVMapGet(&S->globals, &name);
-        idx = sakuraX_TVMapGetIndex(&S->globals, &name);
-
-        if (idx == -1) {
-            for (ull i = 0; i < S->localsSize; i++) {
-                if (s_str_cmp(&name, &S->locals[i]) == 0) {
-                    // load the value into the next register
-                    reg = assembly->registers++;
-
-                    if (i != reg)
-                        SakuraAssembly_push3(assembly, SAKURA_MOVE, reg, i);
-
-                    if (reg >= assembly->highestRegister) {
-                        assembly->highestRegister = reg;
-                    }
-
-                    for (ull j = 0; j < node->argCount; j++) {
-                        sakuraV_visitNode(S, assembly, node->args[j]);
-                    }
-
-                    SakuraAssembly_push3(assembly, SAKURA_CALL, reg, node->argCount);
-                    assembly->registers -= (node->argCount + 1);
-
-                    LOG_POP();
-                    return;
-                }
+        name.str = (char *)node->left->token.start;
+        name.len = node->left->token.length;
+
+        idx = sakuraY_findLocal(S, &name);
+        if (idx != -1) {
+            // load the value into the next register
+            reg = assembly->registers++;
+            SakuraAssembly_pushABC(assembly, SAKURA_MOVE, reg, idx, 0);
+        } else {
+            // get the function from the global table. functions declared further down get their slot reserved here,
+            // calling it before the declaration has run is a runtime error
+            idx = sakuraX_TVMapSlot(&S->globals, &name);
+            func = &S->globals.pairs[idx].value;
+
+            // check if the function is a function
+            if (TV_TYPE(*func) != SAKURA_TCFUNC && TV_TYPE(*func) != SAKURA_TFUNC && TV_TYPE(*func) != SAKURA_TNIL) {
+                printf("Error: '%.*s' is not a function\n", name.len, name.str);
+                LOG_POP();
+                return;
             }
-        }
 
-        // check if the function exists
-        if (idx == -1) {
-            printf("Error: function '%.*s' does not exist\n", name.len, name.str);
-            LOG_POP();
-            return;
+            // bytecode to call the function
+            reg = assembly->registers++;
+            assembly->functionsLoaded++;
+            SakuraAssembly_pushABx(assembly, SAKURA_GETGLOBAL, reg, idx);
         }
-
-        // check if the function is a function
-        if (func->tt != SAKURA_TCFUNC && func->tt != SAKURA_TFUNC) {
-            printf("Error: '%.*s' is not a function\n", name.len, name.str);
-            LOG_POP();
-            return;
-        }
-
-        // bytecode to call the function
-        reg = assembly->registers++;
-        assembly->functionsLoaded++;
-        SakuraAssembly_push3(assembly, SAKURA_GETGLOBAL, reg, idx);
-
-        if (reg >= assembly->highestRegister) {
-            assembly->highestRegister = reg;
-        }
-
-        // bytecode to push arguments onto the stack
-        for (ull i = 0; i < node->argCount; i++) {
-            sakuraV_visitNode(S, assembly, node->args[i]);
-        }
-
-        SakuraAssembly_push3(assembly, SAKURA_CALL, reg, node->argCount);
-        assembly->registers -= (node->argCount + 1);
-
-        node->leftLocation = reg;
     } else {
         // visit the function
         sakuraV_visitNode(S, assembly, node->left);
+        reg = node->left->leftLocation;
+    }
 
-        // bytecode to push arguments onto the stack
-        for (ull i = 0; i < node->argCount; i++) {
-            sakuraV_visitNode(S, assembly, node->args[i]);
-        }
+    if (reg >= assembly->highestRegister) {
+        assembly->highestRegister = reg;
+    }
 
-        SakuraAssembly_push3(assembly, SAKURA_CALL, node->left->leftLocation, node->argCount);
-        assembly->registers -= (node->argCount + 1);
-        node->leftLocation = node->left->leftLocation;
+    // bytecode to put the arguments in the registers after the function
+    for (ull i = 0; i < node->argCount; i++) {
+        sakuraV_visitNode(S, assembly, node->args[i]);
     }
 
+    // the result replaces the function in its register. a tail call is followed by a return of that register, which
+    // only runs when the callee can't take over the frame (C functions and calls straight from C)
+    if (tail) {
+        SakuraAssembly_pushABC(assembly, SAKURA_TAILCALL, reg, node->argCount, 0);
+        SakuraAssembly_pushABC(assembly, SAKURA_RETURN, reg, 1, 0);
+    } else {
+        SakuraAssembly_pushABC(assembly, SAKURA_CALL, reg, node->argCount, 0);
+    }
+    assembly->registers = reg + 1;
+    node->leftLocation = reg;
+
     LOG_POP();
 }
 
 void sakuraV_visitIndex(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
-    ;
+    LOG_CALL();
+
+    // visit the table and the key
+    sakuraV_visitNode(S, assembly, node->left);
+    sakuraV_visitNode(S, assembly, node->right);
+
+    // the value replaces the table in its register
+    SakuraAssembly_pushABC(assembly, SAKURA_GETTABLE, node->left->leftLocation, node->left->leftLocation,
+                         node->right->leftLocation);
+    assembly->registers--;
+    node->leftLocation = node->left->leftLocation;
+
+    LOG_POP();
 }
 
 void sakuraV_visitIf(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
@@ -346,30 +359,28 @@ void sakuraV_visitIf(SakuraState *S, struct SakuraAssembly *assembly, struct Nod
     sakuraV_visitNode(S, assembly, node->left);
 
     // bytecode to jump to the else block if the condition is false
-    jump = assembly->size;
-    SakuraAssembly_push3(assembly, SAKURA_JMPIF, 0, node->left->leftLocation);
+    jump = SakuraAssembly_pushABx(assembly, SAKURA_JMPIF, node->left->leftLocation, 0);
     assembly->registers--;
 
     // visit the if block
     sakuraV_visitNode(S, assembly, node->right);
 
     // check if theres an else block
-    if (node->right != NULL) {
+    if (node->elseBlock != NULL) {
         // bytecode to jump to the end of the if statement
-        end = assembly->size;
-        SakuraAssembly_push2(assembly, SAKURA_JMP, 0);
+        end = SakuraAssembly_pushABx(assembly, SAKURA_JMP, 0, 0);
 
         // set the jump location
-        assembly->instructions[jump + 1] = assembly->size;
+        SakuraAssembly_patchBx(assembly, jump, assembly->size);
 
         // visit the else block
         sakuraV_visitNode(S, assembly, node->elseBlock);
 
         // set the end location
-        assembly->instructions[end + 1] = assembly->size;
+        SakuraAssembly_patchBx(assembly, end, assembly->size);
     } else {
         // set the jump location
-        assembly->instructions[jump + 1] = assembly->size;
+        SakuraAssembly_patchBx(assembly, jump, assembly->size);
     }
 
     LOG_POP();
@@ -386,8 +397,7 @@ void sakuraV_visitWhile(SakuraState *S, struct SakuraAssembly *assembly, struct
         sakuraV_visitNode(S, assembly, node->left);
 
         // bytecode to jump to the else block if the condition is false
-        jump = assembly->size;
-        SakuraAssembly_push3(assembly, SAKURA_JMPIF, 0, node->left->leftLocation);
+        jump = SakuraAssembly_pushABx(assembly, SAKURA_JMPIF, node->left->leftLocation, 0);
         assembly->registers--;
     }
 
@@ -395,55 +405,77 @@ void sakuraV_visitWhile(SakuraState *S, struct SakuraAssembly *assembly, struct
     sakuraV_visitNode(S, assembly, node->right);
 
     // bytecode to jump to the start of the while loop
-    SakuraAssembly_push2(assembly, SAKURA_JMP, start);
+    SakuraAssembly_pushABx(assembly, SAKURA_JMP, 0, start);
 
     // set the jump location
     if (node->left != NULL)
-        assembly->instructions[jump + 1] = assembly->size;
+        SakuraAssembly_patchBx(assembly, jump, assembly->size);
 
     LOG_POP();
 }
 
 void sakuraV_visitBlock(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
+    ull scope, localCount = assembly->localCount;
+
     LOG_CALL();
 
+    scope = sakuraY_openScope(S);
+
     for (ull i = 0; i < node->argCount; i++) {
         sakuraV_visitNode(S, assembly, node->args[i]);
+        // temporaries of a statement are dead once it ends
+        assembly->registers = assembly->localCount;
     }
 
+    // locals declared in the block go out of scope with it, their registers are free for the next statement
+    sakuraY_closeScope(S, scope);
+    assembly->localCount = localCount;
+    assembly->registers = localCount;
+
     LOG_POP();
 }
 
 void sakuraV_visitVar(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
     struct s_str name;
-    ull reg;
+    int idx;
 
     LOG_CALL();
 
     // get the variable name as an s_str
-    name.str = (char *)node->token->start;
-    name.len = node->token->length;
+    name.str = (char *)node->token.start;
+    name.len = node->token.length;
 
-    // push the value onto the stack
-    reg = assembly->registers;
+    // evaluate the value into the next register
     sakuraV_visitNode(S, assembly, node->left);
-    assembly->registers--;
 
-    // store the register location in the node
-    sakuraY_storeLocal(S, &name, reg);
+    idx = sakuraY_findLocal(S, &name);
+    if (idx != -1) {
+        // redeclaring a local reuses its register
+        SakuraAssembly_pushABC(assembly, SAKURA_MOVE, idx, node->left->leftLocation, 0);
+        assembly->registers--;
+    } else {
+        // the register now belongs to the local
+        sakuraY_storeLocal(S, &name, node->left->leftLocation);
+        assembly->localCount = node->left->leftLocation + 1;
+    }
 
     LOG_POP();
 }
 
 void sakuraV_visitTable(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
-    ull reg, tblIdx, keyIdx = 0;
+    ull reg, tblIdx, keyIdx = 0, positional = 0;
     int index;
 
     LOG_CALL();
 
-    // create a new table
+    // create a new table, with array slots for the positional elements
+    for (ull i = 0; i < node->argCount; i++) {
+        if (node->keys[i] == NULL)
+            positional++;
+    }
+
     reg = assembly->registers++;
-    SakuraAssembly_push3(assembly, SAKURA_NEWTABLE, reg, node->argCount);
+    SakuraAssembly_pushABx(assembly, SAKURA_NEWTABLE, reg, positional);
 
     // store the register location in the node
     node->leftLocation = reg;
@@ -457,14 +489,14 @@ void sakuraV_visitTable(SakuraState *S, struct SakuraAssembly *assembly, struct
         if (node->keys[i] == NULL) {
             tblIdx = keyIdx++;
             // push idx as a constant and use that
-            index = sakuraX_pushKNumber(assembly, tblIdx);
+            index = sakuraX_pushKInteger(assembly, (long long)tblIdx);
             sakuraV_visitNode(S, assembly, node->args[i]);
-            SakuraAssembly_push4(assembly, SAKURA_SETTABLE, reg, index, node->args[i]->leftLocation);
+            SakuraAssembly_pushABC(assembly, SAKURA_SETTABLE, reg, index, node->args[i]->leftLocation);
             assembly->registers--;
         } else {
             sakuraV_visitNode(S, assembly, node->keys[i]);
             sakuraV_visitNode(S, assembly, node->args[i]);
-            SakuraAssembly_push4(assembly, SAKURA_SETTABLE, reg, node->keys[i]->leftLocation,
+            SakuraAssembly_pushABC(assembly, SAKURA_SETTABLE, reg, node->keys[i]->leftLocation,
                                  node->args[i]->leftLocation);
             assembly->registers -= 2;
         }
@@ -473,6 +505,22 @@ void sakuraV_visitTable(SakuraState *S, struct SakuraAssembly *assembly, struct
     LOG_POP();
 }
 
+void sakuraV_visitReturn(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
+    LOG_CALL();
+
+    if (node->left == NULL) {
+        SakuraAssembly_pushABC(assembly, SAKURA_RETURN, 0, 0, 0);
+    } else if (node->left->type == SAKURA_NODE_CALL) {
+        // returning a call hands the frame over to the callee
+        sakuraV_visitCallA(S, assembly, node->left, 1);
+    } else {
+        sakuraV_visitNode(S, assembly, node->left);
+        SakuraAssembly_pushABC(assembly, SAKURA_RETURN, node->left->leftLocation, 1, 0);
+    }
+
+    LOG_POP();
+}
+
 void sakuraV_visitNode(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node) {
     LOG_CALL();
 
@@ -513,6 +561,12 @@ void sakuraV_visitNode(SakuraState *S, struct SakuraAssembly *assembly, struct N
     case SAKURA_NODE_TABLE:
         sakuraV_visitTable(S, assembly, node);
         break;
+    case SAKURA_NODE_INDEX:
+        sakuraV_visitIndex(S, assembly, node);
+        break;
+    case SAKURA_NODE_RETURN:
+        sakuraV_visitReturn(S, assembly, node);
+        break;
     default:
         printf("Error: unknown node type '%d'\n", node->type);
         break;
@@ -524,30 +578,40 @@ void sakuraV_visitNode(SakuraState *S, struct SakuraAssembly *assembly, struct N
 struct SakuraAssembly *sakuraY_assemble(SakuraState *S, struct NodeStack *nodes) {
     struct SakuraAssembly *assembly;
     struct Node *node;
+    struct SakuraSymbolTable outerLocals;
 
     LOG_CALL();
 
     S->currentState = SAKURA_FLAG_ASSEMBLING;
     assembly = SakuraAssembly();
 
+    // every chunk runs in its own register window
+    sakuraY_enterLocals(S, &outerLocals);
+
     for (ull i = 0; i < nodes->size; i++) {
         node = nodes->nodes[i];
         sakuraV_visitNode(S, assembly, node);
+        assembly->registers = assembly->localCount;
     }
 
-    SakuraAssembly_push3(assembly, SAKURA_RETURN, 0, 0);
+    SakuraAssembly_pushABC(assembly, SAKURA_RETURN, 0, 0, 0);
+    sakuraX_widenJumps(assembly);
+
+    sakuraY_leaveLocals(S, &outerLocals);
+
+    sakuraX_optimizeAssembly(assembly);
 
     LOG_POP();
     return assembly;
 }
 
-struct SakuraAssembly *SakuraAssembly_new(int fullSetup) {
+struct SakuraAssembly *SakuraAssembly_new(SakuraConstantPool *pool) {
     struct SakuraAssembly *assembly;
 
     LOG_CALL();
 
     assembly = (struct SakuraAssembly *)malloc(sizeof(struct SakuraAssembly));
-    assembly->instructions = (int *)malloc(64 * sizeof(int));
+    assembly->instructions = (uint32_t *)malloc(64 * sizeof(uint32_t));
     assembly->size = 0;
     assembly->capacity = 64;
 
@@ -556,13 +620,24 @@ struct SakuraAssembly *SakuraAssembly_new(int fullSetup) {
     assembly->highestRegister = 0;
     assembly->functionsLoaded = 0;
 
+    assembly->localCount = 0;
+    assembly->parameters = 0;
+
+    memset(assembly->peepholeHits, 0, sizeof(assembly->peepholeHits));
+
+    assembly->farJumps = NULL;
+    assembly->farJumpCount = 0;
+    assembly->farJumpCapacity = 0;
+
     assembly->closures = (struct SakuraAssembly **)malloc(4 * sizeof(struct SakuraAssembly *));
     assembly->closureCapacity = 4;
     assembly->closureIdx = 0;
 
-    assembly->pool.size = 0;
-    assembly->pool.capacity = fullSetup ? 8 : 0;
-    assembly->pool.constants = fullSetup ? (TValue *)malloc(assembly->pool.capacity * sizeof(TValue)) : NULL;
+    // a function shares the pool of the assembly it's declared in, so its constants are interned with the chunk's
+    if (pool == NULL)
+        pool = sakuraX_newPool();
+    pool->refs++;
+    assembly->pool = pool;
 
     LOG_POP();
     return assembly;
@@ -571,15 +646,9 @@ struct SakuraAssembly *SakuraAssembly_new(int fullSetup) {
 void sakuraX_freeAssembly(struct SakuraAssembly *assembly) {
     LOG_CALL();
 
-    if (assembly->pool.constants) {
-        for (ull i = 0; i < assembly->pool.size; i++) {
-            if (assembly->pool.constants[i].tt == SAKURA_TSTR)
-                s_str_free(&assembly->pool.constants[i].value.s);
-        }
-
-        free(assembly->pool.constants);
-        assembly->pool.constants = NULL;
-        assembly->pool.size = 0;
+    if (assembly->pool) {
+        sakuraX_releasePool(assembly->pool);
+        assembly->pool = NULL;
     }
 
     if (assembly->instructions) {
@@ -587,6 +656,11 @@ void sakuraX_freeAssembly(struct SakuraAssembly *assembly) {
         assembly->instructions = NULL;
     }
 
+    if (assembly->farJumps) {
+        free(assembly->farJumps);
+        assembly->farJumps = NULL;
+    }
+
     if (assembly->closures) {
         for (ull i = 0; i < assembly->closureIdx; i++)
             sakuraX_freeAssembly(assembly->closures[i]);
@@ -599,57 +673,299 @@ void sakuraX_freeAssembly(struct SakuraAssembly *assembly) {
     LOG_POP();
 }
 
-void SakuraAssembly_push(struct SakuraAssembly *assembly, int instruction) {
+void SakuraAssembly_push(struct SakuraAssembly *assembly, uint32_t instruction) {
     if (assembly->size >= assembly->capacity) {
         assembly->capacity *= 2;
-        assembly->instructions = (int *)realloc(assembly->instructions, assembly->capacity * sizeof(int));
+        assembly->instructions =
+            (uint32_t *)realloc(assembly->instructions, assembly->capacity * sizeof(uint32_t));
     }
     assembly->instructions[assembly->size++] = instruction;
 }
 
-void SakuraAssembly_push2(struct SakuraAssembly *assembly, int instruction, int a) {
-    SakuraAssembly_push(assembly, instruction);
-    SakuraAssembly_push(assembly, a);
+ull SakuraAssembly_pushABC(struct SakuraAssembly *assembly, int op, int a, int b, int c) {
+    ull pc = assembly->size;
+
+    if (a >= 0 && a <= SAKURA_MAX_A && b >= SAKURA_MIN_B && b <= SAKURA_MAX_B && c >= SAKURA_MIN_B &&
+        c <= SAKURA_MAX_B) {
+        SakuraAssembly_push(assembly, (uint32_t)op | (uint32_t)a << 8 | ((uint32_t)b & 0xff) << 16 |
+                                          ((uint32_t)c & 0xff) << 24);
+    } else {
+        SakuraAssembly_push(assembly, SAKURA_WIDE | (uint32_t)op << 8);
+        SakuraAssembly_push(assembly, (uint32_t)a);
+        SakuraAssembly_push(assembly, (uint32_t)b);
+        SakuraAssembly_push(assembly, (uint32_t)c);
+    }
+
+    return pc;
 }
 
-void SakuraAssembly_push3(struct SakuraAssembly *assembly, int instruction, int a, int b) {
-    SakuraAssembly_push(assembly, instruction);
-    SakuraAssembly_push2(assembly, a, b);
+ull SakuraAssembly_pushABx(struct SakuraAssembly *assembly, int op, int a, int bx) {
+    ull pc = assembly->size;
+
+    if (a >= 0 && a <= SAKURA_MAX_A && bx >= SAKURA_MIN_BX && bx <= SAKURA_MAX_BX) {
+        SakuraAssembly_push(assembly, (uint32_t)op | (uint32_t)a << 8 | ((uint32_t)bx & 0xffff) << 16);
+    } else {
+        SakuraAssembly_push(assembly, SAKURA_WIDE | (uint32_t)op << 8);
+        SakuraAssembly_push(assembly, (uint32_t)a);
+        SakuraAssembly_push(assembly, (uint32_t)bx);
+        SakuraAssembly_push(assembly, 0);
+    }
+
+    return pc;
 }
 
-void SakuraAssembly_push4(struct SakuraAssembly *assembly, int instruction, int a, int b, int c) {
-    SakuraAssembly_push2(assembly, instruction, a);
-    SakuraAssembly_push2(assembly, b, c);
+ull SakuraAssembly_pushInstruction(struct SakuraAssembly *assembly, const struct SakuraInstruction *ins) {
+    if (sakuraX_opHasBx(ins->op))
+        return SakuraAssembly_pushABx(assembly, ins->op, ins->a, ins->bx);
+    return SakuraAssembly_pushABC(assembly, ins->op, ins->a, ins->b, ins->c);
 }
 
-int sakuraX_pushKNumber(struct SakuraAssembly *assembly, double value) {
-    ull idx;
+void SakuraAssembly_patchOp(struct SakuraAssembly *assembly, ull pc, int op) {
+    uint32_t *instruction = &assembly->instructions[pc];
 
-    if (assembly->pool.size >= assembly->pool.capacity) {
-        assembly->pool.capacity *= 2;
-        assembly->pool.constants =
-            (TValue *)realloc(assembly->pool.constants, assembly->pool.capacity * sizeof(TValue));
+    // a wide instruction keeps its opcode in the a field of the prefix
+    if (SAKURA_GET_OP(*instruction) == SAKURA_WIDE)
+        *instruction = (*instruction & ~((uint32_t)0xff << 8)) | (uint32_t)op << 8;
+    else
+        *instruction = (*instruction & ~(uint32_t)0xff) | (uint32_t)op;
+}
+
+void SakuraAssembly_patchBx(struct SakuraAssembly *assembly, ull pc, int bx) {
+    uint32_t *instruction = &assembly->instructions[pc];
+
+    if (SAKURA_GET_OP(*instruction) == SAKURA_WIDE) {
+        instruction[2] = (uint32_t)bx;
+        return;
     }
 
-    idx = assembly->pool.size;
-    assembly->pool.constants[assembly->pool.size++] = (TValue){.value.n = value, .tt = SAKURA_TNUMFLT};
-    return -(idx + 1);
+    // forward jumps are emitted before their target is known, one that lands out of reach is kept aside and grows
+    // to the wide form when the code is laid out again at the end of the function
+    if (bx < SAKURA_MIN_BX || bx > SAKURA_MAX_BX) {
+        if (assembly->farJumpCount + 2 > assembly->farJumpCapacity) {
+            assembly->farJumpCapacity = assembly->farJumpCapacity == 0 ? 8 : assembly->farJumpCapacity * 2;
+            assembly->farJumps = (ull *)realloc(assembly->farJumps, assembly->farJumpCapacity * sizeof(ull));
+            if (assembly->farJumps == NULL) {
+                printf("Error: failed to allocate memory for far jumps\n");
+                exit(1);
+            }
+        }
+
+        assembly->farJumps[assembly->farJumpCount++] = pc;
+        assembly->farJumps[assembly->farJumpCount++] = (ull)bx;
+        bx = 0;
+    }
+
+    *instruction = (*instruction & 0xffff) | ((uint32_t)bx & 0xffff) << 16;
 }
 
-int sakuraX_pushKString(struct SakuraAssembly *assembly, const struct s_str *value) {
+void sakuraX_decodeInstruction(const struct SakuraAssembly *assembly, ull pc, struct SakuraInstruction *out) {
+    uint32_t instruction = assembly->instructions[pc];
+
+    if (SAKURA_GET_OP(instruction) == SAKURA_WIDE) {
+        out->op = SAKURA_GET_A(instruction);
+        out->a = (int)assembly->instructions[pc + 1];
+        out->b = (int)assembly->instructions[pc + 2];
+        out->c = (int)assembly->instructions[pc + 3];
+        out->bx = out->b;
+        out->size = SAKURA_WIDE_SIZE;
+    } else {
+        out->op = SAKURA_GET_OP(instruction);
+        out->a = SAKURA_GET_A(instruction);
+        out->b = SAKURA_GET_B(instruction);
+        out->c = SAKURA_GET_C(instruction);
+        out->bx = SAKURA_GET_BX(instruction);
+        out->size = 1;
+    }
+}
+
+int sakuraX_opHasBx(int op) {
+    switch (op) {
+    case SAKURA_LOADK:
+    case SAKURA_GETGLOBAL:
+    case SAKURA_SETGLOBAL:
+    case SAKURA_NEWTABLE:
+    case SAKURA_CLOSURE:
+    case SAKURA_JMP:
+    case SAKURA_JMPIF:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// the number of words SakuraAssembly_pushInstruction writes for ins
+int sakuraX_instructionSize(const struct SakuraInstruction *ins) {
+    if (ins->a < 0 || ins->a > SAKURA_MAX_A)
+        return SAKURA_WIDE_SIZE;
+    if (sakuraX_opHasBx(ins->op))
+        return ins->bx >= SAKURA_MIN_BX && ins->bx <= SAKURA_MAX_BX ? 1 : SAKURA_WIDE_SIZE;
+    return ins->b >= SAKURA_MIN_B && ins->b <= SAKURA_MAX_B && ins->c >= SAKURA_MIN_B && ins->c <= SAKURA_MAX_B
+               ? 1
+               : SAKURA_WIDE_SIZE;
+}
+
+SakuraConstantPool *sakuraX_newPool(void) {
+    SakuraConstantPool *pool = (SakuraConstantPool *)malloc(sizeof(SakuraConstantPool));
+    if (pool == NULL) {
+        printf("Error: failed to allocate memory for constant pool\n");
+        exit(1);
+    }
+
+    pool->capacity = 8;
+    pool->size = 0;
+    pool->constants = (TValue *)malloc(pool->capacity * sizeof(TValue));
+
+    pool->indexCapacity = 16;
+    pool->index = (uint32_t *)calloc(pool->indexCapacity, sizeof(uint32_t));
+
+    pool->refs = 0;
+    return pool;
+}
+
+void sakuraX_releasePool(SakuraConstantPool *pool) {
+    if (--pool->refs > 0)
+        return;
+
+    for (ull i = 0; i < pool->size; i++) {
+        if (TV_TYPE(pool->constants[i]) == SAKURA_TSTR)
+            free(TV_STR(pool->constants[i]));
+    }
+
+    free(pool->constants);
+    free(pool->index);
+    free(pool);
+}
+
+uint32_t sakuraX_hashKNumber(double value) {
+    uint64_t bits;
+
+    // constants are told apart by their bits, so 0 and -0 stay separate
+    memcpy(&bits, &value, sizeof(bits));
+    return (uint32_t)sakuraX_mixHash(bits);
+}
+
+// integer constants are kept apart from floats with the same value, the salt keeps them off each other's hashes too
+uint32_t sakuraX_hashKInteger(long long value) {
+    return (uint32_t)sakuraX_mixHash((uint64_t)value ^ 0x9e3779b97f4a7c15ULL);
+}
+
+uint32_t sakuraX_hashKString(const char *str, ull len) { return (uint32_t)sakuraX_hashBytes(str, len, 0); }
+
+uint32_t sakuraX_hashK(const TValue *value) {
+    if (TV_TYPE(*value) == SAKURA_TSTR)
+        return sakuraX_hashKString(TV_STR(*value)->str, TV_STR(*value)->len);
+    if (TV_ISINT(*value))
+        return sakuraX_hashKInteger(TV_INT(*value));
+
+    return sakuraX_hashKNumber(TV_NUM(*value));
+}
+
+ull sakuraX_findKSlot(SakuraConstantPool *pool, uint32_t hash, const TValue *number, const struct s_str *string) {
+    ull mask = pool->indexCapacity - 1, slot = hash & mask;
+
+    // a string is looked up by its bytes, so a duplicate never gets allocated
+    for (; pool->index[slot] != 0; slot = (slot + 1) & mask) {
+        const TValue *constant = &pool->constants[pool->index[slot] - 1];
+
+        if (string != NULL) {
+            if (TV_TYPE(*constant) == SAKURA_TSTR && (ull)TV_STR(*constant)->len == (ull)string->len &&
+                memcmp(TV_STR(*constant)->str, string->str, string->len) == 0)
+                return slot;
+        } else if (TV_TYPE(*constant) == SAKURA_TNUMFLT && TV_TYPE(*number) == SAKURA_TNUMFLT) {
+            double a = TV_NUM(*constant), b = TV_NUM(*number);
+            if (memcmp(&a, &b, sizeof(double)) == 0)
+                return slot;
+        } else if (TV_ISINT(*constant) && TV_ISINT(*number) && TV_INT(*constant) == TV_INT(*number)) {
+            return slot;
+        }
+    }
+
+    return slot;
+}
+
+int sakuraX_addK(SakuraConstantPool *pool, ull slot, TValue value) {
     ull idx;
 
-    if (assembly->pool.size >= assembly->pool.capacity) {
-        assembly->pool.capacity *= 2;
-        assembly->pool.constants =
-            (TValue *)realloc(assembly->pool.constants, assembly->pool.capacity * sizeof(TValue));
+    if (pool->size >= pool->capacity) {
+        pool->capacity *= 2;
+        pool->constants = (TValue *)realloc(pool->constants, pool->capacity * sizeof(TValue));
+    }
+
+    idx = pool->size;
+    pool->constants[pool->size++] = value;
+    pool->index[slot] = (uint32_t)(idx + 1);
+
+    // rebuilding in pool order keeps the newest constant last in its probe run, which sakuraX_truncateK relies on
+    if (pool->size * 2 > pool->indexCapacity) {
+        ull mask;
+
+        free(pool->index);
+        pool->indexCapacity *= 2;
+        pool->index = (uint32_t *)calloc(pool->indexCapacity, sizeof(uint32_t));
+        mask = pool->indexCapacity - 1;
+
+        for (ull i = 0; i < pool->size; i++) {
+            ull s = sakuraX_hashK(&pool->constants[i]) & mask;
+            while (pool->index[s] != 0)
+                s = (s + 1) & mask;
+            pool->index[s] = (uint32_t)(i + 1);
+        }
     }
 
-    idx = assembly->pool.size;
-    assembly->pool.constants[assembly->pool.size++] = (TValue){.value.s = s_str_copy(value), .tt = SAKURA_TSTR};
     return -(idx + 1);
 }
 
+int sakuraX_pushKValue(struct SakuraAssembly *assembly, TValue number) {
+    ull slot = sakuraX_findKSlot(assembly->pool, sakuraX_hashK(&number), &number, NULL);
+
+    if (assembly->pool->index[slot] != 0)
+        return -(int)assembly->pool->index[slot];
+
+    return sakuraX_addK(assembly->pool, slot, number);
+}
+
+int sakuraX_pushKNumber(struct SakuraAssembly *assembly, double value) {
+    return sakuraX_pushKValue(assembly, sakuraY_makeTNumber(value));
+}
+
+int sakuraX_pushKInteger(struct SakuraAssembly *assembly, long long value) {
+    // a nan boxed integer too wide for its payload comes out of sakuraY_makeTInteger as a float
+    return sakuraX_pushKValue(assembly, sakuraY_makeTInteger(value));
+}
+
+int sakuraX_pushKLiteral(struct SakuraAssembly *assembly, const struct SakuraNumber *value) {
+    if (value->isInteger)
+        return sakuraX_pushKInteger(assembly, value->i);
+    return sakuraX_pushKNumber(assembly, value->n);
+}
+
+int sakuraX_pushKString(struct SakuraAssembly *assembly, const struct s_str *value) {
+    ull slot = sakuraX_findKSlot(assembly->pool, sakuraX_hashKString(value->str, value->len), NULL, value);
+
+    if (assembly->pool->index[slot] != 0)
+        return -(int)assembly->pool->index[slot];
+
+    return sakuraX_addK(assembly->pool, slot, sakuraY_makeTString(value));
+}
+
+void sakuraX_truncateK(SakuraConstantPool *pool, ull size) {
+    ull mask = pool->indexCapacity - 1;
+
+    // only the newest constants go, nothing was inserted after them so their slots can simply be emptied
+    while (pool->size > size) {
+        TValue *constant = &pool->constants[pool->size - 1];
+        ull slot = sakuraX_hashK(constant) & mask;
+
+        while (pool->index[slot] != pool->size)
+            slot = (slot + 1) & mask;
+        pool->index[slot] = 0;
+
+        if (TV_TYPE(*constant) == SAKURA_TSTR)
+            free(TV_STR(*constant));
+        pool->size--;
+    }
+}
+
 void SakuraAssembly_pushChildAssembly(struct SakuraAssembly *assembly, struct SakuraAssembly *child) {
     if (assembly->closureIdx >= assembly->closureCapacity) {
         assembly->closureCapacity *= 2;
@@ -6,10 +6,25 @@
 #include "parser.h"
 #include "sakura.h"
 
+// rewrites made by the peephole pass, counted per assembly and listed by the disassembler
+enum SakuraPeepholeRule {
+    SAKURA_PEEPHOLE_MOVE_SELF,     // mov a, a is dropped
+    SAKURA_PEEPHOLE_JUMP_NEXT,     // a jump to the instruction right after it is dropped
+    SAKURA_PEEPHOLE_JUMP_CHAIN,    // a jump landing on a jmp goes straight to its target
+    SAKURA_PEEPHOLE_NOT_EQUAL,     // eq a, b, c followed by not a, a becomes ne a, b, c
+    SAKURA_PEEPHOLE_MOVE_RESULT,   // an operation into a temporary that's then moved writes the target directly
+    SAKURA_PEEPHOLE_MOVE_OPERAND,  // a register copied into a temporary is read in place by the operation using it
+    SAKURA_PEEPHOLE_COMPARE_JUMP,  // a comparison only tested by the jmpif after it becomes a compare-and-branch
+    SAKURA_PEEPHOLE_CONST_OPERAND, // a constant loaded just for the next operation is read from the pool by it
+    SAKURA_PEEPHOLE_GLOBAL_CALL,   // a global loaded only to be called is loaded by the call
+    SAKURA_PEEPHOLE_TYPED,         // arithmetic on operands inferred to be integers or floats skips the tag checks
+    SAKURA_PEEPHOLE_RULE_COUNT,
+};
+
 // constant pool structure
 struct SakuraAssembly {
-    int *instructions;
-    SakuraConstantPool pool;
+    uint32_t *instructions;
+    SakuraConstantPool *pool;
     ull size;
     ull capacity;
     ull registers;
@@ -20,29 +35,60 @@ struct SakuraAssembly {
 
     ull highestRegister;
     ull functionsLoaded;
+
+    ull localCount; // registers held by locals, temporaries are allocated above them
+    ull parameters; // number of parameters, these are the first registers of the frame
+
+    ull peepholeHits[SAKURA_PEEPHOLE_RULE_COUNT];
+
+    // forward jumps whose target didn't fit the packed operand once it was known, as pairs of the jump's word offset
+    // and its target. sakuraX_widenJumps lays the code out again with these jumps in the wide form
+    ull *farJumps;
+    ull farJumpCount;
+    ull farJumpCapacity;
 };
 
 // assembly instructions
 
+// every instruction is packed into one 32-bit word, the opcode in the low 8 bits followed by the operands a (unsigned),
+// b and c (signed) of 8 bits each. instructions taking a wide operand bx (constants, global slots, closures, table
+// sizes and jump targets) use the 16 bits of b and c for it instead. jump targets are instruction word indices.
+#define SAKURA_GET_OP(i) ((int)((i)&0xff))
+#define SAKURA_GET_A(i) ((int)(((i) >> 8) & 0xff))
+#define SAKURA_GET_B(i) ((int)(int8_t)((i) >> 16))
+#define SAKURA_GET_C(i) ((int)(int8_t)((i) >> 24))
+#define SAKURA_GET_BX(i) ((int)(int16_t)((i) >> 16))
+
+#define SAKURA_MAX_A 255
+#define SAKURA_MIN_B -128
+#define SAKURA_MAX_B 127
+#define SAKURA_MIN_BX -32768
+#define SAKURA_MAX_BX 32767
+
+// an instruction whose operands don't fit is written in the wide form instead: a SAKURA_WIDE word carrying the opcode
+// in a, followed by a, b and c (or bx) as full words
+#define SAKURA_WIDE_SIZE 4
+
 // Stack Manipulation
 #define SAKURA_MOVE 0    // mov a, b -> moves the value of b to a
-#define SAKURA_LOADK 1   // loadk a -> loads the constant at index a into the stack
+#define SAKURA_LOADK 1   // loadk a, bx -> loads the constant at index bx into a
 #define SAKURA_LOADNIL 2 // loadnil a, b -> loads nil into a, a + 1, ..., a + b
 #define SAKURA_POP 17    // pop a -> pops a values from the stack
 
 // Global Variable Operations
-#define SAKURA_GETGLOBAL 3 // getglobal a -> loads the global at index a into the stack
-#define SAKURA_SETGLOBAL 4 // setglobal a, b -> sets the global at index a to b
+#define SAKURA_GETGLOBAL 3 // getglobal a, bx -> loads the global in slot bx into a
+#define SAKURA_SETGLOBAL 4 // setglobal a, bx -> sets the global in slot bx to a
 
 // Table Operations
-#define SAKURA_NEWTABLE 33 // newtable a, b -> creates a new table with b size and stores it in a
-#define SAKURA_GETTABLE 5  // gettable a, b, c -> loads the value at index b in the table at index a into c
+#define SAKURA_NEWTABLE 33 // newtable a, bx -> creates a new table with bx array slots and stores it in a
+#define SAKURA_GETTABLE 5  // gettable a, b, c -> loads the value at index c in the table at index b into a
 #define SAKURA_SETTABLE 6  // settable a, b, c -> sets the value at index b in the table at index a to c
 
 // Function/Closure Operations
-#define SAKURA_CLOSURE 7 // closure a, b -> creates a closure from the function at index b and stores it in a
-#define SAKURA_CALL 8    // call a, b, c -> calls function at index c, with a return values, and b arguments
-#define SAKURA_RETURN 9  // return a, b -> returns from a function with a and b range of values
+#define SAKURA_CLOSURE 7   // closure a, bx -> creates a closure from the function at index bx and stores it in a
+#define SAKURA_CALL 8      // call a, b -> calls the function at a with b arguments, the result replaces the function
+#define SAKURA_RETURN 9    // return a, b -> returns from a function with a and b range of values
+#define SAKURA_TAILCALL 34 // tailcall a, b -> calls the function at a with b arguments, reusing the current frame
 
 // Arithmetic Operations
 #define SAKURA_ADD 10 // add a, b, c -> adds the values at index b and c and stores it in a
@@ -58,10 +104,11 @@ struct SakuraAssembly {
 #define SAKURA_LT 19  // lt a, b, c -> checks if index b is less than the value at index c and stores it in a
 #define SAKURA_LE 20  // le a, b, c -> checks if index b is less than or equal to the value at index c and stores it in a
 #define SAKURA_NOT 21 // not a, b -> inverts the bool at b and stores it in a
+#define SAKURA_NE 36  // ne a, b, c -> checks if the values at index b and c are not equal and stores it in a
 
 // Control Flow
-#define SAKURA_JMP 22   // jmp a -> jumps to the instruction at index a
-#define SAKURA_JMPIF 23 // jmpif a, b -> jumps to the instruction at index a if the value at index b is false
+#define SAKURA_JMP 22   // jmp bx -> jumps to the instruction at index bx
+#define SAKURA_JMPIF 23 // jmpif a, bx -> jumps to the instruction at index bx if the value at index a is false
 
 // String Manipulation
 #define SAKURA_CONCAT 24 // concat a, b, c -> concatenates the values at b through c and stores in a
@@ -78,14 +125,70 @@ struct SakuraAssembly {
 #define SAKURA_SHL 31  // shl a, b, c -> bitwise shifts index b left by the value at index c and stores it in a
 #define SAKURA_SHR 32  // shr a, b, c -> bitwise shifts index b right by the value at index c and stores it in a
 
+// Encoding
+#define SAKURA_WIDE 35 // wide op -> runs op with the operands in the next 3 words
+
+// Superinstructions, only written by the peephole pass
+#define SAKURA_ADDK 37       // addk a, b, c -> adds the constant at index c to the value at index b and stores it in a
+#define SAKURA_SUBK 38       // subk a, b, c -> subtracts the constant at index c from the value at index b into a
+#define SAKURA_MULK 39       // mulk a, b, c -> multiplies the value at index b by the constant at index c into a
+#define SAKURA_LTJMP 40      // ltjmp b, c -> skips the jmp that follows if b is less than c, runs it otherwise
+#define SAKURA_LEJMP 41      // lejmp b, c -> skips the jmp that follows if b is less than or equal to c
+#define SAKURA_EQJMP 42      // eqjmp b, c -> skips the jmp that follows if b and c are equal
+#define SAKURA_NEJMP 43      // nejmp b, c -> skips the jmp that follows if b and c are not equal
+#define SAKURA_CALLGLOBAL 44 // callglobal a, b, c -> loads the global in slot c into a and calls it with b arguments
+
+// Quickened arithmetic, the vm rewrites an operation into the version for the operand types it has seen, and back
+// when the operands stop having those types
+#define SAKURA_ADDN 45  // addn a, b, c -> add with a float operand, the other one may be an integer
+#define SAKURA_SUBN 46  // subn a, b, c -> sub with a float operand, the other one may be an integer
+#define SAKURA_MULN 47  // muln a, b, c -> mul with a float operand, the other one may be an integer
+#define SAKURA_DIVN 48  // divn a, b, c -> div for number operands of either subtype
+#define SAKURA_ADDKN 49 // addkn a, b, c -> addk when the operand or the constant is a float
+#define SAKURA_SUBKN 50 // subkn a, b, c -> subk when the operand or the constant is a float
+#define SAKURA_MULKN 51 // mulkn a, b, c -> mulk when the operand or the constant is a float
+#define SAKURA_ADDI 52  // addi a, b, c -> add for integer operands
+#define SAKURA_SUBI 53  // subi a, b, c -> sub for integer operands
+#define SAKURA_MULI 54  // muli a, b, c -> mul for integer operands
+#define SAKURA_ADDKI 55 // addki a, b, c -> addk for an integer operand and an integer constant
+#define SAKURA_SUBKI 56 // subki a, b, c -> subk for an integer operand and an integer constant
+#define SAKURA_MULKI 57 // mulki a, b, c -> mulk for an integer operand and an integer constant
+
+// Typed arithmetic, only written by the peephole pass once type inference proved the subtype of every operand, so
+// these run without checking any tags
+#define SAKURA_TADDI 58    // taddi a, b, c -> add of two integers
+#define SAKURA_TSUBI 59    // tsubi a, b, c -> sub of two integers
+#define SAKURA_TMULI 60    // tmuli a, b, c -> mul of two integers
+#define SAKURA_TADDKI 61   // taddki a, b, c -> addk of an integer and an integer constant
+#define SAKURA_TSUBKI 62   // tsubki a, b, c -> subk of an integer and an integer constant
+#define SAKURA_TMULKI 63   // tmulki a, b, c -> mulk of an integer and an integer constant
+#define SAKURA_TADDF 64    // taddf a, b, c -> add of two floats
+#define SAKURA_TSUBF 65    // tsubf a, b, c -> sub of two floats
+#define SAKURA_TMULF 66    // tmulf a, b, c -> mul of two floats
+#define SAKURA_TDIVF 67    // tdivf a, b, c -> div of two floats
+#define SAKURA_TADDKF 68   // taddkf a, b, c -> addk of a float and a float constant
+#define SAKURA_TSUBKF 69   // tsubkf a, b, c -> subk of a float and a float constant
+#define SAKURA_TMULKF 70   // tmulkf a, b, c -> mulk of a float and a float constant
+#define SAKURA_TLTJMPI 71  // tltjmpi b, c -> ltjmp of two integers
+#define SAKURA_TLEJMPI 72  // tlejmpi b, c -> lejmp of two integers
+#define SAKURA_TLTJMPF 73  // tltjmpf b, c -> ltjmp of two floats
+#define SAKURA_TLEJMPF 74  // tlejmpf b, c -> lejmp of two floats
+
+#define SAKURA_OPCODE_COUNT 75 // one past the highest opcode, the dispatch table sends the rest to the error
+
 struct SakuraAssembly *sakuraY_assemble(SakuraState *S, struct NodeStack *nodes);
 
+// emit an operation on registers, shared by the ast visitors and the single-pass compiler
+void sakuraX_emitUnary(struct SakuraAssembly *assembly, enum TokenType op, int reg);
+int sakuraX_emitBinary(struct SakuraAssembly *assembly, enum TokenType op, int dest, int left, int right);
+
 // visitor functions
 void sakuraV_visitNode(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitBlock(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitUnary(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitBinary(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitCall(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
+void sakuraV_visitCallA(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node, int tail);
 void sakuraV_visitIndex(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitFunction(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitIf(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
@@ -95,17 +198,44 @@ void sakuraV_visitIdentifier(SakuraState *S, struct SakuraAssembly *assembly, st
 void sakuraV_visitWhile(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitVar(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 void sakuraV_visitTable(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
+void sakuraV_visitReturn(SakuraState *S, struct SakuraAssembly *assembly, struct Node *node);
 
-#define SakuraAssembly() SakuraAssembly_new(1)
+#define SakuraAssembly() SakuraAssembly_new(NULL)
 
-struct SakuraAssembly *SakuraAssembly_new(int fullSetup);
+struct SakuraAssembly *SakuraAssembly_new(SakuraConstantPool *pool);
 void sakuraX_freeAssembly(struct SakuraAssembly *assembly);
-void SakuraAssembly_push(struct SakuraAssembly *assembly, int instruction);
-void SakuraAssembly_push2(struct SakuraAssembly *assembly, int instruction, int a);
-void SakuraAssembly_push3(struct SakuraAssembly *assembly, int instruction, int a, int b);
-void SakuraAssembly_push4(struct SakuraAssembly *assembly, int instruction, int a, int b, int c);
+void SakuraAssembly_push(struct SakuraAssembly *assembly, uint32_t instruction);
+ull SakuraAssembly_pushABC(struct SakuraAssembly *assembly, int op, int a, int b, int c);
+ull SakuraAssembly_pushABx(struct SakuraAssembly *assembly, int op, int a, int bx);
+void SakuraAssembly_patchOp(struct SakuraAssembly *assembly, ull pc, int op);
+void SakuraAssembly_patchBx(struct SakuraAssembly *assembly, ull pc, int bx);
+
+// an instruction with its operands unpacked, size is the number of words it takes
+struct SakuraInstruction {
+    int op;
+    int a, b, c, bx;
+    int size;
+};
 
+void sakuraX_decodeInstruction(const struct SakuraAssembly *assembly, ull pc, struct SakuraInstruction *out);
+ull SakuraAssembly_pushInstruction(struct SakuraAssembly *assembly, const struct SakuraInstruction *ins);
+int sakuraX_opHasBx(int op);
+int sakuraX_instructionSize(const struct SakuraInstruction *ins);
+
+// constants are interned, pushing a value that's already in the pool returns its index
+SakuraConstantPool *sakuraX_newPool(void);
+void sakuraX_releasePool(SakuraConstantPool *pool);
+uint32_t sakuraX_hashKNumber(double value);
+uint32_t sakuraX_hashKInteger(long long value);
+uint32_t sakuraX_hashKString(const char *str, ull len);
+uint32_t sakuraX_hashK(const TValue *value);
+ull sakuraX_findKSlot(SakuraConstantPool *pool, uint32_t hash, const TValue *number, const struct s_str *string);
+int sakuraX_addK(SakuraConstantPool *pool, ull slot, TValue value);
+int sakuraX_pushKValue(struct SakuraAssembly *assembly, TValue number);
 int sakuraX_pushKNumber(struct SakuraAssembly *assembly, double value);
+int sakuraX_pushKInteger(struct SakuraAssembly *assembly, long long value);
+int sakuraX_pushKLiteral(struct SakuraAssembly *assembly, const struct SakuraNumber *value);
 int sakuraX_pushKString(struct SakuraAssembly *assembly, const struct s_str *value);
+void sakuraX_truncateK(SakuraConstantPool *pool, ull size);
 
 void SakuraAssembly_pushChildAssembly(struct SakuraAssembly *assembly, struct SakuraAssembly *child);
\ No newline at end of file
@@ -0,0 +1,493 @@
+#include "compiler.h"
+
+#include <stdlib.h>
+
+#include "peephole.h"
+#include "slexer.h"
+
+// the single-pass compiler covers the straight-line subset of the language: let, return, calls, tables, indexing and
+// arithmetic. every compile function returns 0 on anything outside that subset or on a syntax error, without printing
+// anything, and sakuraY_compileSource runs the source through the parser instead so errors read the same either way
+
+int sakuraX_reserveRegister(struct SakuraCompiler *C) {
+    ull reg = C->assembly->registers++;
+
+    if (reg >= C->assembly->highestRegister) {
+        C->assembly->highestRegister = reg;
+    }
+
+    return (int)reg;
+}
+
+void sakuraX_dischargeExpr(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    if (e->kind == SAKURA_EXPR_NUMBER) {
+        // the constant goes into the pool before the register is taken, same as sakuraV_visitNumber
+        int index = sakuraX_pushKLiteral(C->assembly, &e->number);
+        e->reg = sakuraX_reserveRegister(C);
+        SakuraAssembly_pushABx(C->assembly, SAKURA_LOADK, e->reg, index);
+    }
+
+    e->kind = SAKURA_EXPR_REGISTER;
+}
+
+void sakuraX_advanceToken(struct SakuraCompiler *C) { C->hasToken = sakuraX_lexToken(&C->tokens, &C->token); }
+
+int sakuraX_checkToken(struct SakuraCompiler *C, enum TokenType type) { return C->hasToken && C->token.type == type; }
+
+int sakuraX_checkKeyword(struct SakuraCompiler *C, const char *keyword) {
+    return C->hasToken && C->token.type == SAKURA_TOKEN_IDENTIFIER &&
+           str_cmp_cl(C->token.start, C->token.length, keyword) == 0;
+}
+
+int sakuraX_expectToken(struct SakuraCompiler *C, enum TokenType type) {
+    if (!sakuraX_checkToken(C, type))
+        return 0;
+
+    sakuraX_advanceToken(C);
+    return 1;
+}
+
+int sakuraX_compileIdentifier(struct SakuraCompiler *C, struct SakuraExpr *e, const struct Token *name) {
+    struct s_str str;
+    int idx;
+
+    str.str = (char *)name->start;
+    str.len = name->length;
+
+    e->kind = SAKURA_EXPR_REGISTER;
+    e->reg = sakuraX_reserveRegister(C);
+
+    // locals shadow globals, an unknown variable is left to the ast path to report
+    idx = sakuraY_findLocal(C->S, &str);
+    if (idx != -1) {
+        SakuraAssembly_pushABC(C->assembly, SAKURA_MOVE, e->reg, idx, 0);
+        return 1;
+    }
+
+    idx = sakuraX_TVMapGetIndex(&C->S->globals, &str);
+    if (idx == -1)
+        return 0;
+
+    SakuraAssembly_pushABx(C->assembly, SAKURA_GETGLOBAL, e->reg, idx);
+    return 1;
+}
+
+int sakuraX_compileNamedCallee(struct SakuraCompiler *C, struct SakuraExpr *e, const struct Token *name) {
+    struct s_str str;
+    TValue *func;
+    int idx;
+
+    str.str = (char *)name->start;
+    str.len = name->length;
+
+    e->kind = SAKURA_EXPR_REGISTER;
+
+    idx = sakuraY_findLocal(C->S, &str);
+    if (idx != -1) {
+        e->reg = sakuraX_reserveRegister(C);
+        SakuraAssembly_pushABC(C->assembly, SAKURA_MOVE, e->reg, idx, 0);
+        return 1;
+    }
+
+    // a global callee gets its slot reserved like in sakuraV_visitCallA, so it may be declared later
+    idx = sakuraX_TVMapSlot(&C->S->globals, &str);
+    func = &C->S->globals.pairs[idx].value;
+    if (TV_TYPE(*func) != SAKURA_TCFUNC && TV_TYPE(*func) != SAKURA_TFUNC && TV_TYPE(*func) != SAKURA_TNIL)
+        return 0;
+
+    e->reg = sakuraX_reserveRegister(C);
+    C->assembly->functionsLoaded++;
+    SakuraAssembly_pushABx(C->assembly, SAKURA_GETGLOBAL, e->reg, idx);
+    return 1;
+}
+
+int sakuraX_compileCall(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    int argCount = 0, closed = 0;
+
+    sakuraX_dischargeExpr(C, e);
+    sakuraX_advanceToken(C);
+
+    // the arguments go in the registers right after the function
+    while (C->hasToken && C->token.type != SAKURA_TOKEN_RIGHT_PAREN) {
+        struct SakuraExpr arg;
+
+        if (!sakuraX_compileEntry(C, &arg))
+            return 0;
+        sakuraX_dischargeExpr(C, &arg);
+        argCount++;
+
+        if (sakuraX_expectToken(C, SAKURA_TOKEN_RIGHT_PAREN)) {
+            closed = 1;
+            break;
+        } else if (!sakuraX_expectToken(C, SAKURA_TOKEN_COMMA)) {
+            return 0;
+        }
+    }
+
+    if (!closed && !sakuraX_expectToken(C, SAKURA_TOKEN_RIGHT_PAREN))
+        return 0;
+
+    // the result replaces the function in its register, a return can still turn the call into a tail call
+    e->kind = SAKURA_EXPR_CALL;
+    e->call = SakuraAssembly_pushABC(C->assembly, SAKURA_CALL, e->reg, argCount, 0);
+    C->assembly->registers = e->reg + 1;
+    return 1;
+}
+
+int sakuraX_compileIndex(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    struct SakuraExpr key;
+
+    sakuraX_dischargeExpr(C, e);
+    sakuraX_advanceToken(C);
+
+    if (!sakuraX_compileEntry(C, &key))
+        return 0;
+    sakuraX_dischargeExpr(C, &key);
+
+    if (!sakuraX_expectToken(C, SAKURA_TOKEN_RIGHT_SQUARE))
+        return 0;
+
+    // the value replaces the table in its register
+    SakuraAssembly_pushABC(C->assembly, SAKURA_GETTABLE, e->reg, e->reg, key.reg);
+    C->assembly->registers--;
+    return 1;
+}
+
+int sakuraX_compilePostfix(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    while (C->hasToken) {
+        if (C->token.type == SAKURA_TOKEN_LEFT_PAREN) {
+            if (!sakuraX_compileCall(C, e))
+                return 0;
+        } else if (C->token.type == SAKURA_TOKEN_LEFT_SQUARE) {
+            if (!sakuraX_compileIndex(C, e))
+                return 0;
+        } else {
+            break;
+        }
+    }
+
+    return 1;
+}
+
+int sakuraX_compileTable(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    ull table, positional = 0;
+
+    e->kind = SAKURA_EXPR_REGISTER;
+    e->reg = sakuraX_reserveRegister(C);
+
+    // the number of array slots is only known at the closing brace
+    table = SakuraAssembly_pushABx(C->assembly, SAKURA_NEWTABLE, e->reg, 0);
+
+    while (C->hasToken && C->token.type != SAKURA_TOKEN_RIGHT_BRACE) {
+        struct SakuraExpr key, value;
+
+        if (sakuraX_expectToken(C, SAKURA_TOKEN_LEFT_SQUARE)) {
+            if (!sakuraX_compileEntry(C, &key))
+                return 0;
+            sakuraX_dischargeExpr(C, &key);
+
+            if (!sakuraX_expectToken(C, SAKURA_TOKEN_RIGHT_SQUARE) || !sakuraX_expectToken(C, SAKURA_TOKEN_EQUAL))
+                return 0;
+
+            if (!sakuraX_compileEntry(C, &value))
+                return 0;
+            sakuraX_dischargeExpr(C, &value);
+
+            SakuraAssembly_pushABC(C->assembly, SAKURA_SETTABLE, e->reg, key.reg, value.reg);
+            C->assembly->registers -= 2;
+        } else {
+            // positional elements are keyed by a constant index
+            key.reg = sakuraX_pushKInteger(C->assembly, (long long)positional++);
+            if (!sakuraX_compileEntry(C, &value))
+                return 0;
+            sakuraX_dischargeExpr(C, &value);
+
+            SakuraAssembly_pushABC(C->assembly, SAKURA_SETTABLE, e->reg, key.reg, value.reg);
+            C->assembly->registers--;
+        }
+
+        if (!sakuraX_expectToken(C, SAKURA_TOKEN_COMMA) && !sakuraX_checkToken(C, SAKURA_TOKEN_RIGHT_BRACE))
+            return 0;
+    }
+
+    if (!sakuraX_expectToken(C, SAKURA_TOKEN_RIGHT_BRACE))
+        return 0;
+
+    // the count only sizes the array part, so it's capped rather than widened
+    SakuraAssembly_patchBx(C->assembly, table, positional > SAKURA_MAX_BX ? SAKURA_MAX_BX : positional);
+    return 1;
+}
+
+int sakuraX_compileFactor(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    struct Token token = C->token;
+
+    if (!C->hasToken)
+        return 0;
+
+    sakuraX_advanceToken(C);
+    switch (token.type) {
+    case SAKURA_TOKEN_NUMBER:
+        // kept out of the pool until something needs it in a register
+        e->kind = SAKURA_EXPR_NUMBER;
+        e->number = sakuraX_parseNumber(&token);
+        return 1;
+    case SAKURA_TOKEN_STRING: {
+        struct s_str val;
+        int index;
+
+        val.str = (char *)token.start;
+        val.len = token.length;
+        index = sakuraX_pushKString(C->assembly, &val);
+
+        e->kind = SAKURA_EXPR_REGISTER;
+        e->reg = sakuraX_reserveRegister(C);
+        SakuraAssembly_pushABx(C->assembly, SAKURA_LOADK, e->reg, index);
+        return 1;
+    }
+    case SAKURA_TOKEN_BANG:
+    case SAKURA_TOKEN_HASHTAG:
+    case SAKURA_TOKEN_PLUS:
+    case SAKURA_TOKEN_MINUS: {
+        enum TokenType op = token.type;
+
+        if (!sakuraX_compileFactor(C, e))
+            return 0;
+
+        if (e->kind == SAKURA_EXPR_NUMBER) {
+            // the parser only folds signs into number literals, the other operators are an error it reports
+            if (op == SAKURA_TOKEN_MINUS)
+                sakuraX_negateNumber(&e->number);
+            return op == SAKURA_TOKEN_MINUS || op == SAKURA_TOKEN_PLUS;
+        }
+
+        e->kind = SAKURA_EXPR_REGISTER;
+        sakuraX_emitUnary(C->assembly, op, e->reg);
+        return 1;
+    }
+    case SAKURA_TOKEN_LEFT_BRACE:
+        return sakuraX_compileTable(C, e);
+    case SAKURA_TOKEN_LEFT_PAREN:
+        if (!sakuraX_compileEntry(C, e) || !sakuraX_expectToken(C, SAKURA_TOKEN_RIGHT_PAREN))
+            return 0;
+
+        // the ast calls a parenthesized name through the global slot like a plain call, that case is left to it
+        if (sakuraX_checkToken(C, SAKURA_TOKEN_LEFT_PAREN))
+            return 0;
+
+        return sakuraX_compilePostfix(C, e);
+    case SAKURA_TOKEN_IDENTIFIER:
+        if (sakuraX_checkToken(C, SAKURA_TOKEN_LEFT_PAREN)) {
+            if (!sakuraX_compileNamedCallee(C, e, &token))
+                return 0;
+        } else if (!sakuraX_compileIdentifier(C, e, &token)) {
+            return 0;
+        }
+
+        return sakuraX_compilePostfix(C, e);
+    default:
+        return 0;
+    }
+}
+
+int sakuraX_compileBinary(struct SakuraCompiler *C, struct SakuraExpr *e, int minPower) {
+    if (!sakuraX_compileFactor(C, e))
+        return 0;
+
+    // same precedence climbing as sakuraX_parseBinary, emitting as it goes
+    while (C->hasToken && sakuraX_bindingPower[C->token.type] > minPower) {
+        enum TokenType op = C->token.type;
+        struct SakuraExpr right;
+        ull size = C->assembly->size, poolSize = C->assembly->pool->size;
+        ull highest = C->assembly->highestRegister;
+        int pending = e->kind == SAKURA_EXPR_NUMBER, left;
+        struct SakuraNumber folded = e->number;
+
+        sakuraX_advanceToken(C);
+
+        // the left side is loaded before the right side is compiled, like the ast visits it
+        sakuraX_dischargeExpr(C, e);
+        left = e->reg;
+        if (!sakuraX_compileBinary(C, &right, sakuraX_bindingPower[op]))
+            return 0;
+
+        // two literals fold into one, the right side emitted nothing so only the load of the left has to go
+        if (pending && right.kind == SAKURA_EXPR_NUMBER && sakuraX_foldBinary(op, &folded, &right.number)) {
+            C->assembly->size = size;
+            sakuraX_truncateK(C->assembly->pool, poolSize);
+            C->assembly->highestRegister = highest;
+            C->assembly->registers--;
+
+            e->kind = SAKURA_EXPR_NUMBER;
+            e->number = folded;
+            continue;
+        }
+
+        sakuraX_dischargeExpr(C, &right);
+
+        C->assembly->registers -= 2;
+        e->kind = SAKURA_EXPR_REGISTER;
+        e->reg = sakuraX_reserveRegister(C);
+        if (!sakuraX_emitBinary(C->assembly, op, e->reg, left, right.reg))
+            return 0;
+    }
+
+    return 1;
+}
+
+int sakuraX_compileEntry(struct SakuraCompiler *C, struct SakuraExpr *e) {
+    // a let inside an expression has no value the compiler could use
+    if (sakuraX_checkKeyword(C, "let"))
+        return 0;
+
+    return sakuraX_compileBinary(C, e, 0);
+}
+
+int sakuraX_compileLet(struct SakuraCompiler *C) {
+    struct Token name;
+    struct SakuraExpr value;
+    struct s_str str;
+    int idx;
+
+    sakuraX_advanceToken(C);
+    name = C->token;
+    if (!sakuraX_expectToken(C, SAKURA_TOKEN_IDENTIFIER))
+        return 0;
+
+    if (!sakuraX_expectToken(C, SAKURA_TOKEN_EQUAL) || !sakuraX_compileEntry(C, &value))
+        return 0;
+    sakuraX_dischargeExpr(C, &value);
+
+    str.str = (char *)name.start;
+    str.len = name.length;
+
+    idx = sakuraY_findLocal(C->S, &str);
+    if (idx != -1) {
+        // redeclaring a local reuses its register
+        SakuraAssembly_pushABC(C->assembly, SAKURA_MOVE, idx, value.reg, 0);
+        C->assembly->registers--;
+    } else {
+        // the register now belongs to the local
+        sakuraY_storeLocal(C->S, &str, value.reg);
+        C->assembly->localCount = value.reg + 1;
+    }
+
+    return 1;
+}
+
+int sakuraX_compileReturn(struct SakuraCompiler *C) {
+    struct SakuraExpr value;
+
+    sakuraX_advanceToken(C);
+
+    if (!C->hasToken) {
+        SakuraAssembly_pushABC(C->assembly, SAKURA_RETURN, 0, 0, 0);
+        return 1;
+    } else if (C->token.type == SAKURA_TOKEN_RIGHT_BRACE) {
+        return 0;
+    }
+
+    if (!sakuraX_compileEntry(C, &value))
+        return 0;
+
+    if (value.kind == SAKURA_EXPR_CALL) {
+        // returning a call hands the frame over to the callee
+        SakuraAssembly_patchOp(C->assembly, value.call, SAKURA_TAILCALL);
+        SakuraAssembly_pushABC(C->assembly, SAKURA_RETURN, value.reg, 1, 0);
+    } else {
+        sakuraX_dischargeExpr(C, &value);
+        SakuraAssembly_pushABC(C->assembly, SAKURA_RETURN, value.reg, 1, 0);
+    }
+
+    return 1;
+}
+
+int sakuraX_compileStatement(struct SakuraCompiler *C) {
+    struct SakuraExpr e;
+    int ok;
+
+    // blocks need jumps patched across nested scopes and functions need their own assembly, both go through the ast
+    if (sakuraX_checkToken(C, SAKURA_TOKEN_LEFT_BRACE) || sakuraX_checkKeyword(C, "if") ||
+        sakuraX_checkKeyword(C, "while") || sakuraX_checkKeyword(C, "loop") || sakuraX_checkKeyword(C, "fn"))
+        return 0;
+
+    if (sakuraX_checkKeyword(C, "let")) {
+        ok = sakuraX_compileLet(C);
+    } else if (sakuraX_checkKeyword(C, "return")) {
+        ok = sakuraX_compileReturn(C);
+    } else {
+        ok = sakuraX_compileEntry(C, &e);
+        if (ok)
+            sakuraX_dischargeExpr(C, &e);
+    }
+
+    // the parser would apply a call or index on the next line to the whole statement
+    if (!ok || sakuraX_checkToken(C, SAKURA_TOKEN_LEFT_PAREN) || sakuraX_checkToken(C, SAKURA_TOKEN_LEFT_SQUARE))
+        return 0;
+
+    // temporaries of a statement are dead once it ends
+    C->assembly->registers = C->assembly->localCount;
+    return 1;
+}
+
+struct SakuraAssembly *sakuraY_compile(SakuraState *S, struct s_str *source) {
+    struct SakuraCompiler C;
+    struct SakuraSymbolTable outerLocals;
+    int ok = 1;
+
+    LOG_CALL();
+
+    if (sakuraX_scanClass == NULL)
+        sakuraX_initLexer();
+
+    C.S = S;
+    sakuraX_initTokStack(&C.tokens, source->str, source->len);
+    C.tokens.quiet = 1;
+    sakuraX_advanceToken(&C);
+
+    S->currentState = SAKURA_FLAG_ASSEMBLING;
+    C.assembly = SakuraAssembly();
+
+    // every chunk runs in its own register window
+    sakuraY_enterLocals(S, &outerLocals);
+
+    while (ok && C.hasToken)
+        ok = sakuraX_compileStatement(&C);
+
+    sakuraY_leaveLocals(S, &outerLocals);
+
+    if (!ok || C.tokens.invalid > 0) {
+        sakuraX_freeAssembly(C.assembly);
+        LOG_POP();
+        return NULL;
+    }
+
+    // no peephole pass here, it would cost more than compiling the chunk did. short chunks are picked for latency and
+    // the code the ast takes for everything else still goes through it
+    SakuraAssembly_pushABC(C.assembly, SAKURA_RETURN, 0, 0, 0);
+
+    LOG_POP();
+    return C.assembly;
+}
+
+struct SakuraAssembly *sakuraY_compileSource(SakuraState *S, struct s_str *source) {
+    struct SakuraAssembly *assembly = NULL;
+    struct TokenStack *tokens;
+    struct NodeStack *nodes;
+
+    LOG_CALL();
+
+    // short chunks skip the ast, anything the single-pass compiler doesn't cover is compiled again from the start
+    if (source->len <= SAKURA_FAST_COMPILE_LIMIT)
+        assembly = sakuraY_compile(S, source);
+
+    if (assembly == NULL) {
+        tokens = sakuraY_analyze(S, source);
+        nodes = sakuraY_parse(S, tokens);
+        sakuraX_freeTokStack(tokens);
+        assembly = sakuraY_assemble(S, nodes);
+        sakuraX_resetNodeArena(&S->nodeArena);
+    }
+
+    LOG_POP();
+    return assembly;
+}
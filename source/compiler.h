@@ -0,0 +1,56 @@
+#pragma once
+
+#include "assembler.h"
+#include "parser.h"
+
+// sources up to this many bytes try the single-pass compiler first, 0 always builds the ast
+#ifndef SAKURA_FAST_COMPILE_LIMIT
+#define SAKURA_FAST_COMPILE_LIMIT 1024
+#endif
+
+// where the value of an expression lives while the single-pass compiler works on it
+enum SakuraExprKind {
+    SAKURA_EXPR_NUMBER,   // a number literal that hasn't been loaded yet, so it can still be folded
+    SAKURA_EXPR_REGISTER, // a value in register reg
+    SAKURA_EXPR_CALL,     // the result of the call at pc, in register reg
+};
+
+struct SakuraExpr {
+    enum SakuraExprKind kind;
+    struct SakuraNumber number;
+    int reg;
+    ull call;
+};
+
+// the compiler never looks further than the current token, so it lexes straight into it instead of going through the
+// token ring the parser reads
+struct SakuraCompiler {
+    SakuraState *S;
+    struct TokenStack tokens; // lexer state
+    struct Token token;       // current token
+    int hasToken;             // 0 once the source runs out
+    struct SakuraAssembly *assembly;
+};
+
+struct SakuraAssembly *sakuraY_compile(SakuraState *S, struct s_str *source);
+struct SakuraAssembly *sakuraY_compileSource(SakuraState *S, struct s_str *source);
+
+int sakuraX_reserveRegister(struct SakuraCompiler *C);
+void sakuraX_dischargeExpr(struct SakuraCompiler *C, struct SakuraExpr *e);
+void sakuraX_advanceToken(struct SakuraCompiler *C);
+int sakuraX_checkToken(struct SakuraCompiler *C, enum TokenType type);
+int sakuraX_checkKeyword(struct SakuraCompiler *C, const char *keyword);
+int sakuraX_expectToken(struct SakuraCompiler *C, enum TokenType type);
+
+int sakuraX_compileIdentifier(struct SakuraCompiler *C, struct SakuraExpr *e, const struct Token *name);
+int sakuraX_compileNamedCallee(struct SakuraCompiler *C, struct SakuraExpr *e, const struct Token *name);
+int sakuraX_compileCall(struct SakuraCompiler *C, struct SakuraExpr *e);
+int sakuraX_compileIndex(struct SakuraCompiler *C, struct SakuraExpr *e);
+int sakuraX_compilePostfix(struct SakuraCompiler *C, struct SakuraExpr *e);
+int sakuraX_compileTable(struct SakuraCompiler *C, struct SakuraExpr *e);
+int sakuraX_compileFactor(struct SakuraCompiler *C, struct SakuraExpr *e);
+int sakuraX_compileBinary(struct SakuraCompiler *C, struct SakuraExpr *e, int minPower);
+int sakuraX_compileEntry(struct SakuraCompiler *C, struct SakuraExpr *e);
+int sakuraX_compileLet(struct SakuraCompiler *C);
+int sakuraX_compileReturn(struct SakuraCompiler *C);
+int sakuraX_compileStatement(struct SakuraCompiler *C);
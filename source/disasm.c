@@ -1,11 +1,13 @@
 #include "disasm.h"
+#include "peephole.h"
 
 #include <stdlib.h>
 
 void sakuraX_writeDisasm(SakuraState *S, struct SakuraAssembly *assembler, const char *filename, int mode) {
     struct s_str **cachedGlobals;
     struct s_str basicCall;
-    ull idx = 1;
+    struct SakuraInstruction ins;
+    ull idx = 1, hits = 0;
     char *allocVal, *allocVal2, *trueFname;
 
     LOG_CALL();
@@ -13,193 +15,279 @@ void sakuraX_writeDisasm(SakuraState *S, struct SakuraAssembly *assembler, const
     S->currentState = SAKURA_FLAG_DISASSEMBLING;
 
     sakura_printf("\x1b[36m%s \x1b[35m<%s>\x1b[0m (\x1b[33m%lld\x1b[0m instructions, \x1b[33m%lld\x1b[0m bytes)\n",
-                  mode & 1 << 8 ? "function" : "main", filename, assembler->size, assembler->size * sizeof(int));
+                  mode & 1 << 8 ? "function" : "main", filename, assembler->size, assembler->size * sizeof(uint32_t));
     sakura_printf("\x1b[33m%lld\x1b[0m registers, \x1b[33m%lld\x1b[0m closures, \x1b[33m%lld\x1b[0m constants, "
                   "\x1b[33m%lld\x1b[0m functions\n",
-                  assembler->highestRegister, assembler->closureIdx, assembler->pool.size, assembler->functionsLoaded);
+                  assembler->highestRegister, assembler->closureIdx, assembler->pool->size, assembler->functionsLoaded);
+
+    for (int rule = 0; rule < SAKURA_PEEPHOLE_RULE_COUNT; rule++)
+        hits += assembler->peepholeHits[rule];
+
+    if (hits > 0) {
+        sakura_printf("peephole:");
+        for (int rule = 0; rule < SAKURA_PEEPHOLE_RULE_COUNT; rule++)
+            if (assembler->peepholeHits[rule] > 0)
+                sakura_printf(" \x1b[33m%lld\x1b[0m %s", assembler->peepholeHits[rule], sakuraX_peepholeRuleName(rule));
+        sakura_printf("\n");
+    }
 
     basicCall = s_str("loaded_function");
-    cachedGlobals = (struct s_str **)malloc(sizeof(struct s_str *) * (assembler->functionsLoaded * 2));
+    // function names loaded into each register, used to annotate calls
+    cachedGlobals = (struct s_str **)calloc(assembler->highestRegister + 1, sizeof(struct s_str *));
 
-    for (ull i = 0; i < assembler->size; i++) {
-        switch (assembler->instructions[i]) {
+    for (ull i = 0; i < assembler->size; i += ins.size) {
+        sakuraX_decodeInstruction(assembler, i, &ins);
+
+        switch (ins.op) {
         case SAKURA_LOADK: {
-            allocVal = sakuraX_readTValC(&assembler->pool.constants[-assembler->instructions[i + 2] - 1]);
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLOADK\t\t%d\t\t\x1b[30m;;\x1b[0m %s into stack pos "
+            allocVal = sakuraX_readTValC(&assembler->pool->constants[-ins.bx - 1]);
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLOADK\t\t%d\t\t\x1b[30m;;\x1b[0m %s into register "
                           "\x1b[33m%d\x1b[0m\n",
-                          idx, i, assembler->instructions[i + 2], allocVal, assembler->instructions[i + 1]);
+                          idx, i, ins.bx, allocVal, ins.a);
             free(allocVal);
-            i += 2;
             break;
         }
         case SAKURA_ADD: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tADD\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tADD\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_SUB: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tSUB\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tSUB\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_MUL: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tMUL\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tMUL\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_DIV: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tDIV\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tDIV\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_POW: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tPOW\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tPOW\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_MOD: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tMOD\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tMOD\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_EQ: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tEQ\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tEQ\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
+            break;
+        }
+        case SAKURA_NE: {
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tNE\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_LT: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLT\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLT\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_LE: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLE\t\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3]);
-            i += 3;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLE\t\t%d, %d, %d\n", idx, i, ins.a, ins.b, ins.c);
             break;
         }
         case SAKURA_CLOSURE: {
             sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tCLOSURE\t\t%d, %d\t\t\x1b[30m;;\x1b[0m store fn-%d "
-                          "into stack pos "
+                          "into register "
                           "\x1b[33m%d\x1b[0m\n",
-                          idx, i, assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 2], assembler->instructions[i + 1]);
-            i += 2;
+                          idx, i, ins.a, ins.bx, ins.bx, ins.a);
             break;
         }
         case SAKURA_CALL: {
-            struct s_str *key = NULL;
-            if (cachedGlobals + assembler->instructions[i + 1] >= cachedGlobals)
-                key = cachedGlobals[assembler->instructions[i + 1]];
+            struct s_str *key = cachedGlobals[ins.a];
             if (key == NULL)
                 key = &basicCall;
             sakura_printf(
                 "    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tCALL\t\t%d, %d\t\t\x1b[30m;;\x1b[0m \x1b[34m%.*s(\x1b[0m%d "
                 "args...\x1b[34m)\x1b[0m\n",
-                idx, i, assembler->instructions[i + 1], assembler->instructions[i + 2], key->len, key->str,
-                assembler->instructions[i + 2]);
-            cachedGlobals[assembler->instructions[i + 1]] = NULL;
-            i += 2;
+                idx, i, ins.a, ins.b, key->len, key->str, ins.b);
+            cachedGlobals[ins.a] = NULL;
+            break;
+        }
+        case SAKURA_ADDN:
+        case SAKURA_SUBN:
+        case SAKURA_MULN:
+        case SAKURA_DIVN:
+        case SAKURA_ADDI:
+        case SAKURA_SUBI:
+        case SAKURA_MULI: {
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\t%s\t\t%d, %d, %d\n", idx, i,
+                          ins.op == SAKURA_ADDN   ? "ADDN"
+                          : ins.op == SAKURA_SUBN ? "SUBN"
+                          : ins.op == SAKURA_MULN ? "MULN"
+                          : ins.op == SAKURA_DIVN ? "DIVN"
+                          : ins.op == SAKURA_ADDI ? "ADDI"
+                          : ins.op == SAKURA_SUBI ? "SUBI"
+                                                  : "MULI",
+                          ins.a, ins.b, ins.c);
+            break;
+        }
+        case SAKURA_TADDI:
+        case SAKURA_TSUBI:
+        case SAKURA_TMULI:
+        case SAKURA_TADDF:
+        case SAKURA_TSUBF:
+        case SAKURA_TMULF:
+        case SAKURA_TDIVF: {
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\t%s\t\t%d, %d, %d\n", idx, i,
+                          ins.op == SAKURA_TADDI   ? "TADDI"
+                          : ins.op == SAKURA_TSUBI ? "TSUBI"
+                          : ins.op == SAKURA_TMULI ? "TMULI"
+                          : ins.op == SAKURA_TADDF ? "TADDF"
+                          : ins.op == SAKURA_TSUBF ? "TSUBF"
+                          : ins.op == SAKURA_TMULF ? "TMULF"
+                                                   : "TDIVF",
+                          ins.a, ins.b, ins.c);
+            break;
+        }
+        case SAKURA_ADDK:
+        case SAKURA_SUBK:
+        case SAKURA_MULK:
+        case SAKURA_ADDKN:
+        case SAKURA_SUBKN:
+        case SAKURA_MULKN:
+        case SAKURA_ADDKI:
+        case SAKURA_SUBKI:
+        case SAKURA_MULKI:
+        case SAKURA_TADDKI:
+        case SAKURA_TSUBKI:
+        case SAKURA_TMULKI:
+        case SAKURA_TADDKF:
+        case SAKURA_TSUBKF:
+        case SAKURA_TMULKF: {
+            allocVal = sakuraX_readTValC(&assembler->pool->constants[-ins.c - 1]);
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\t%s\t\t%d, %d, %d\t\t\x1b[30m;;\x1b[0m %s\n", idx, i,
+                          ins.op == SAKURA_ADDK     ? "ADDK"
+                          : ins.op == SAKURA_SUBK   ? "SUBK"
+                          : ins.op == SAKURA_MULK   ? "MULK"
+                          : ins.op == SAKURA_ADDKN  ? "ADDKN"
+                          : ins.op == SAKURA_SUBKN  ? "SUBKN"
+                          : ins.op == SAKURA_MULKN  ? "MULKN"
+                          : ins.op == SAKURA_ADDKI  ? "ADDKI"
+                          : ins.op == SAKURA_SUBKI  ? "SUBKI"
+                          : ins.op == SAKURA_MULKI  ? "MULKI"
+                          : ins.op == SAKURA_TADDKI ? "TADDKI"
+                          : ins.op == SAKURA_TSUBKI ? "TSUBKI"
+                          : ins.op == SAKURA_TMULKI ? "TMULKI"
+                          : ins.op == SAKURA_TADDKF ? "TADDKF"
+                          : ins.op == SAKURA_TSUBKF ? "TSUBKF"
+                                                    : "TMULKF",
+                          ins.a, ins.b, ins.c, allocVal);
+            free(allocVal);
+            break;
+        }
+        case SAKURA_LTJMP:
+        case SAKURA_LEJMP:
+        case SAKURA_EQJMP:
+        case SAKURA_NEJMP:
+        case SAKURA_TLTJMPI:
+        case SAKURA_TLEJMPI:
+        case SAKURA_TLTJMPF:
+        case SAKURA_TLEJMPF: {
+            allocVal = sakuraX_readTValC(ins.b < 0 ? &assembler->pool->constants[-ins.b - 1] : NULL);
+            allocVal2 = sakuraX_readTValC(ins.c < 0 ? &assembler->pool->constants[-ins.c - 1] : NULL);
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\t%s\t\t%d, %d\t\t\x1b[30m;;\x1b[0m %s %s\n", idx, i,
+                          ins.op == SAKURA_LTJMP     ? "LTJMP"
+                          : ins.op == SAKURA_LEJMP   ? "LEJMP"
+                          : ins.op == SAKURA_EQJMP   ? "EQJMP"
+                          : ins.op == SAKURA_NEJMP   ? "NEJMP"
+                          : ins.op == SAKURA_TLTJMPI ? "TLTJMPI"
+                          : ins.op == SAKURA_TLEJMPI ? "TLEJMPI"
+                          : ins.op == SAKURA_TLTJMPF ? "TLTJMPF"
+                                                     : "TLEJMPF",
+                          ins.b, ins.c, allocVal, allocVal2);
+            free(allocVal);
+            free(allocVal2);
+            break;
+        }
+        case SAKURA_CALLGLOBAL: {
+            struct s_str *key = &S->globals.pairs[ins.c].key;
+            sakura_printf(
+                "    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tCALLGLOBAL\t%d, %d, %d\t\x1b[30m;;\x1b[0m \x1b[34m%.*s(\x1b[0m%d "
+                "args...\x1b[34m)\x1b[0m\n",
+                idx, i, ins.a, ins.b, ins.c, key->len, key->str, ins.b);
+            cachedGlobals[ins.a] = NULL;
             break;
         }
         case SAKURA_GETGLOBAL: {
-            struct s_str *key = &S->globals.pairs[assembler->instructions[i + 2]].key;
-            cachedGlobals[assembler->instructions[i + 1]] = key;
+            struct s_str *key = &S->globals.pairs[ins.bx].key;
+            cachedGlobals[ins.a] = key;
             sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tGETGLOBAL\t%d\t\t\x1b[30m;;\x1b[0m store "
-                          "\x1b[32m'%.*s'\x1b[0m into stack pos "
+                          "\x1b[32m'%.*s'\x1b[0m into register "
                           "\x1b[33m%d\x1b[0m\n",
-                          idx, i, assembler->instructions[i + 2], key->len, key->str, assembler->instructions[i + 1]);
-            i += 2;
+                          idx, i, ins.bx, key->len, key->str, ins.a);
             break;
         }
         case SAKURA_SETGLOBAL: {
-            allocVal = sakuraX_readTValC(&assembler->pool.constants[-assembler->instructions[i + 2] - 1]);
+            struct s_str *key = &S->globals.pairs[ins.bx].key;
             sakura_printf(
-                "    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tSETGLOBAL\t%d, %d\t\t\x1b[30m;;\x1b[0m sets '%s' from stack pos "
-                "\x1b[33m%d\x1b[0m\n",
-                idx, i, assembler->instructions[i + 1], assembler->instructions[i + 2], allocVal,
-                assembler->instructions[i + 1]);
-            free(allocVal);
-            i += 2;
+                "    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tSETGLOBAL\t%d, %d\t\t\x1b[30m;;\x1b[0m sets \x1b[32m'%.*s'\x1b[0m from "
+                "register \x1b[33m%d\x1b[0m\n",
+                idx, i, ins.a, ins.bx, key->len, key->str, ins.a);
             break;
         }
         case SAKURA_JMP: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tJMP\t\t%d\n", idx, i, assembler->instructions[i + 1]);
-            i += 1;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tJMP\t\t%d\n", idx, i, ins.bx);
             break;
         }
         case SAKURA_JMPIF: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tJMPIF\t\t%d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2]);
-            i += 2;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tJMPIF\t\t%d, %d\n", idx, i, ins.a, ins.bx);
+            break;
+        }
+        case SAKURA_TAILCALL: {
+            struct s_str *key = cachedGlobals[ins.a];
+            if (key == NULL)
+                key = &basicCall;
+            sakura_printf(
+                "    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tTAILCALL\t%d, %d\t\t\x1b[30m;;\x1b[0m \x1b[34m%.*s(\x1b[0m%d "
+                "args...\x1b[34m)\x1b[0m\n",
+                idx, i, ins.a, ins.b, key->len, key->str, ins.b);
             break;
         }
         case SAKURA_RETURN: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tRETURN\t\t%d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2]);
-            i += 2;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tRETURN\t\t%d, %d\n", idx, i, ins.a, ins.b);
             break;
         }
         case SAKURA_NOT: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tNOT\t\t%d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2]);
-            i += 2;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tNOT\t\t%d, %d\n", idx, i, ins.a, ins.b);
+            break;
+        }
+        case SAKURA_LOADNIL: {
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLOADNIL\t\t%d, %d\n", idx, i, ins.a, ins.b);
+            break;
+        }
+        case SAKURA_UNM: {
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tUNM\t\t%d, %d\n", idx, i, ins.a, ins.b);
+            break;
+        }
+        case SAKURA_LENTBL: {
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tLENTBL\t\t%d, %d\n", idx, i, ins.a, ins.b);
             break;
         }
         case SAKURA_MOVE: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tMOVE\t\t%d, %d\n", idx, i,
-                          assembler->instructions[i + 1], assembler->instructions[i + 2]);
-            i += 2;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tMOVE\t\t%d, %d\n", idx, i, ins.a, ins.b);
             break;
         }
         case SAKURA_NEWTABLE: {
-            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tNEWTABLE\t%d, %d, %d\n", idx, i,
-                          assembler->instructions[i + 1], 0, assembler->instructions[i + 2]);
-            i += 2;
+            sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tNEWTABLE\t%d, %d, %d\n", idx, i, ins.a, 0, ins.bx);
             break;
         }
         case SAKURA_SETTABLE: {
-            allocVal = sakuraX_readTValC(assembler->instructions[i + 2] < 0
-                                             ? &assembler->pool.constants[-assembler->instructions[i + 2] - 1]
-                                             : NULL);
-            allocVal2 = sakuraX_readTValC(assembler->instructions[i + 3] < 0
-                                              ? &assembler->pool.constants[-assembler->instructions[i + 3] - 1]
-                                              : NULL);
+            allocVal = sakuraX_readTValC(ins.b < 0 ? &assembler->pool->constants[-ins.b - 1] : NULL);
+            allocVal2 = sakuraX_readTValC(ins.c < 0 ? &assembler->pool->constants[-ins.c - 1] : NULL);
             sakura_printf("    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tSETTABLE\t%d, %d, %d \t\x1b[30m;;\x1b[0m %s %s\n", idx,
-                          i, assembler->instructions[i + 1], assembler->instructions[i + 2],
-                          assembler->instructions[i + 3], allocVal, allocVal2);
-            i += 3;
+                          i, ins.a, ins.b, ins.c, allocVal, allocVal2);
             free(allocVal);
             free(allocVal2);
             break;
         }
         case SAKURA_GETTABLE: {
-            allocVal = sakuraX_readTValC(assembler->instructions[i + 3] < 0
-                                             ? &assembler->pool.constants[-assembler->instructions[i + 3] - 1]
-                                             : NULL);
+            allocVal = sakuraX_readTValC(ins.c < 0 ? &assembler->pool->constants[-ins.c - 1] : NULL);
             sakura_printf(
                 "    \x1b[1;32m%lld\x1b[0m\t(%lld)\t\tGETTABLE\t%d, %d, %d \t\x1b[30m;;\x1b[0m tbl@%d[%s] into "
                 "\x1b[33m%d\x1b[0m\n",
-                idx, i, assembler->instructions[i + 1], assembler->instructions[i + 2], assembler->instructions[i + 3],
-                assembler->instructions[i + 2], allocVal, assembler->instructions[i + 1]);
-            i += 3;
+                idx, i, ins.a, ins.b, ins.c, ins.b, allocVal, ins.a);
             free(allocVal);
             break;
         }
@@ -213,15 +301,15 @@ void sakuraX_writeDisasm(SakuraState *S, struct SakuraAssembly *assembler, const
     if (mode & 1 << 1) {
         printf("Raw Instructions:\n");
         for (ull i = 0; i < assembler->size; i++)
-            printf("%d ", assembler->instructions[i]);
+            printf("%08x ", assembler->instructions[i]);
         printf("\n");
     }
 
     if (mode & 1 << 2) {
-        sakura_printf("Constants Dump (\x1b[33m%p\x1b[0m through \x1b[33m%p\x1b[0m):\n", assembler->pool.constants,
-                      assembler->pool.constants + assembler->pool.size);
-        for (ull i = 0; i < assembler->pool.size; i++) {
-            allocVal = sakuraX_readTValC(&assembler->pool.constants[i]);
+        sakura_printf("Constants Dump (\x1b[33m%p\x1b[0m through \x1b[33m%p\x1b[0m):\n", assembler->pool->constants,
+                      assembler->pool->constants + assembler->pool->size);
+        for (ull i = 0; i < assembler->pool->size; i++) {
+            allocVal = sakuraX_readTValC(&assembler->pool->constants[i]);
             printf("  [%lld] %s\n", i, allocVal);
             free(allocVal);
         }
@@ -1,23 +1,57 @@
+// mmap and fstat are posix, -std=c99 hides them unless asked for
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "filesystem.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 struct s_str readfile(const char *path) {
-    char temp[1024];
-    struct s_str s, ns;
-    FILE *file = fopen(path, "r");
+    struct s_str s;
+    long size;
+    size_t capacity, read;
+    FILE *file = fopen(path, "rb");
 
     if (!file) {
         return SI_NULL_STR;
     }
 
-    s = (struct s_str)S_NULL_STR;
-    while (fgets(temp, 1024, file)) {
-        ns = s_str_concat_c(&s, temp);
-        free(s.str);
-        s = ns;
+    // size the buffer up front so the whole file comes in with one read
+    size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        if (fseek(file, 0, SEEK_SET) != 0)
+            size = -1;
+    }
+
+    // pipes and other unseekable files are read in growing chunks instead
+    capacity = size > 0 ? (size_t)size : 4096;
+    s.str = (char *)malloc(capacity);
+    s.len = 0;
+    if (s.str == NULL) {
+        fclose(file);
+        return SI_NULL_STR;
+    }
+
+    while ((read = fread(s.str + s.len, 1, capacity - s.len, file)) > 0) {
+        s.len += (int)read;
+        if ((size_t)s.len == capacity) {
+            if (size > 0)
+                break;
+
+            capacity *= 2;
+            s.str = (char *)realloc(s.str, capacity);
+        }
     }
 
     fclose(file);
@@ -34,6 +68,65 @@ struct s_str readfile_s(const struct s_str *path) {
     return s;
 }
 
+struct s_file mapfile(const char *path) {
+    struct s_file file;
+
+    file.content = SI_NULL_STR;
+    file.mapLength = 0;
+
+#ifndef _WIN32
+    {
+        struct stat info;
+        void *map;
+        int fd = open(path, O_RDONLY);
+
+        if (fd < 0)
+            return file;
+
+        // empty and special files can't be mapped, they go through readfile below
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && info.st_size <= 0x7FFFFFFF) {
+            map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                // the mapping stays valid after the descriptor is closed
+                close(fd);
+                file.content.str = (char *)map;
+                file.content.len = (int)info.st_size;
+                file.mapLength = (size_t)info.st_size;
+                return file;
+            }
+        }
+
+        close(fd);
+    }
+#endif
+
+    file.content = readfile(path);
+    return file;
+}
+
+struct s_file mapfile_s(const struct s_str *path) {
+    struct s_file file;
+    char *path_c = (char *)malloc(path->len + 1);
+    memcpy(path_c, path->str, path->len);
+    path_c[path->len] = '\0';
+    file = mapfile(path_c);
+    free(path_c);
+    return file;
+}
+
+void unmapfile(struct s_file *file) {
+#ifndef _WIN32
+    if (file->mapLength > 0) {
+        munmap(file->content.str, file->mapLength);
+        file->content = SI_NULL_STR;
+        file->mapLength = 0;
+        return;
+    }
+#endif
+
+    s_str_free(&file->content);
+}
+
 int writefile(const char *path, const struct s_str *s) {
     FILE *file = fopen(path, "w");
     if (!file) {
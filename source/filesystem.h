@@ -1,9 +1,20 @@
 #pragma once
 
+#include <stddef.h>
+
 #include "sstr.h"
 
+// a file's contents mapped read-only into memory, or read into a buffer where mapping isn't possible
+struct s_file {
+    struct s_str content;
+    size_t mapLength; // non-zero when content is a mapping
+};
+
 struct s_str readfile(const char *path);
 struct s_str readfile_s(const struct s_str *path);
+struct s_file mapfile(const char *path);
+struct s_file mapfile_s(const struct s_str *path);
+void unmapfile(struct s_file *file);
 int writefile(const char *path, const struct s_str *content);
 int writefile_c(const char *path, const char *content);
 int removefile(const char *path);
\ No newline at end of file
@@ -155,7 +155,6 @@ void dumpDebugStateInfo(SakuraState *S) {
         sakura_printf("\x1b[33munknown\x1b[0m\n");
         break;
     }
-    sakura_printf(" %s Current internal offset: \x1b[33m%lld\x1b[0m\n", debuggerName, S->internalOffset);
     sakura_printf(" %s Stack capacity: \x1b[33m%d\x1b[0m\n", debuggerName, SAKURA_STACK_SIZE);
     sakura_printf(" %s Stack index: \x1b[33m%d\x1b[0m\n", debuggerName, S->stackIndex);
     sakura_printf("  ");
@@ -163,13 +162,8 @@ void dumpDebugStateInfo(SakuraState *S) {
     sakura_printf(" %s Global table: \x1b[33m%p\x1b[0m\n", debuggerName, S->globals.pairs);
     sakura_printf(" %s Global table size: \x1b[33m%lld\x1b[0m\n", debuggerName, S->globals.capacity);
     sakura_printf(" %s Global table index: \x1b[33m%lld\x1b[0m\n", debuggerName, S->globals.size);
-    sakura_printf(" %s Constant pool: \x1b[33m%p\x1b[0m\n", debuggerName, S->pool.constants);
-    sakura_printf(" %s Constant pool size: \x1b[33m%lld\x1b[0m\n", debuggerName, S->pool.capacity);
-    sakura_printf(" %s Constant pool index: \x1b[33m%lld\x1b[0m\n", debuggerName, S->pool.size);
-    sakura_printf("  ");
-    sakuraDEBUG_dumpConstantPool(&S->pool);
-    sakura_printf(" %s Local table: \x1b[33m%p\x1b[0m\n", debuggerName, S->locals);
-    sakura_printf(" %s Local table size: \x1b[33m%lld\x1b[0m\n", debuggerName, S->localsSize);
+    sakura_printf(" %s Local table: \x1b[33m%p\x1b[0m\n", debuggerName, S->locals.symbols);
+    sakura_printf(" %s Local table size: \x1b[33m%lld\x1b[0m\n", debuggerName, S->locals.size);
     sakura_printf(" %s Last error flag (%d): ", debuggerName, S->error);
     switch (S->error) {
     case SAKURA_EFLAG_NONE:
@@ -1,24 +1,90 @@
 #include "parser.h"
 
-#include <ctype.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
-struct Node *sakuraX_makeNode(enum TokenType type) {
-    struct Node *node = (struct Node *)malloc(sizeof(struct Node));
-    if (node == NULL) {
-        printf("Error: could not allocate memory for node\n");
-        return NULL;
+#include "slexer.h"
+
+void *sakuraX_allocNodeArena(struct NodeArena *arena, size_t size) {
+    struct NodeArenaBlock *block = arena->blocks;
+    void *ptr;
+
+    // every allocation stays 8 byte aligned for the doubles and pointers inside nodes
+    size = (size + 7) & ~(size_t)7;
+
+    if (block == NULL || block->capacity - block->used < size) {
+        size_t capacity = block == NULL ? SAKURA_NODE_ARENA_BLOCK : block->capacity * 2;
+        while (capacity < size)
+            capacity *= 2;
+
+        block = (struct NodeArenaBlock *)malloc(sizeof(struct NodeArenaBlock) + capacity);
+        if (block == NULL) {
+            printf("Error: could not allocate memory for nodes\n");
+            exit(1);
+        }
+
+        block->used = 0;
+        block->capacity = capacity;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void sakuraX_resetNodeArena(struct NodeArena *arena) {
+    struct NodeArenaBlock *block, *next;
+    size_t total = 0;
+
+    if (arena->blocks == NULL)
+        return;
+
+    if (arena->blocks->next == NULL && arena->blocks->capacity <= SAKURA_NODE_ARENA_KEEP) {
+        arena->blocks->used = 0;
+        return;
+    }
+
+    // the last compilation outgrew one block, the next one gets a single block that would have fit it
+    for (block = arena->blocks; block != NULL; block = next) {
+        next = block->next;
+        total += block->capacity;
+        free(block);
+    }
+
+    arena->blocks = NULL;
+    if (total <= SAKURA_NODE_ARENA_KEEP) {
+        sakuraX_allocNodeArena(arena, total);
+        arena->blocks->used = 0;
     }
+}
+
+void sakuraX_freeNodeArena(struct NodeArena *arena) {
+    struct NodeArenaBlock *block, *next;
+
+    for (block = arena->blocks; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+
+    arena->blocks = NULL;
+}
+
+struct Node *sakuraX_makeNode(SakuraState *S, enum TokenType type) {
+    struct Node *node = (struct Node *)sakuraX_allocNodeArena(&S->nodeArena, sizeof(struct Node));
 
     node->type = type;
     node->left = NULL;
     node->right = NULL;
-    node->token = NULL;
+    node->token.type = SAKURA_TOKEN_SENTINEL;
+    node->token.start = NULL;
+    node->token.length = 0;
     node->keys = NULL;
     node->args = NULL;
     node->argCount = 0;
+    node->argCapacity = 0;
     node->elseBlock = NULL;
     node->leftLocation = -11111111;  // value is chosen as a poison
     node->rightLocation = -11111111; // value is chosen as a poison
@@ -26,60 +92,95 @@ struct Node *sakuraX_makeNode(enum TokenType type) {
     return node;
 }
 
+void sakuraX_addNodeArg(SakuraState *S, struct Node *node, struct Node *key, struct Node *arg) {
+    // the arena can't grow an array in place, so the capacity doubles and the old array is left behind
+    if (node->argCount == node->argCapacity) {
+        size_t capacity = node->argCapacity < 4 ? 4 : node->argCapacity * 2;
+        struct Node **args = (struct Node **)sakuraX_allocNodeArena(&S->nodeArena, capacity * sizeof(struct Node *));
+
+        if (node->argCount > 0)
+            memcpy(args, node->args, node->argCount * sizeof(struct Node *));
+        node->args = args;
+
+        // only table constructors have keys
+        if (node->type == SAKURA_NODE_TABLE) {
+            struct Node **keys =
+                (struct Node **)sakuraX_allocNodeArena(&S->nodeArena, capacity * sizeof(struct Node *));
+
+            if (node->argCount > 0)
+                memcpy(keys, node->keys, node->argCount * sizeof(struct Node *));
+            node->keys = keys;
+        }
+
+        node->argCapacity = capacity;
+    }
+
+    if (node->type == SAKURA_NODE_TABLE)
+        node->keys[node->argCount] = key;
+    node->args[node->argCount++] = arg;
+}
+
 void sakuraDEBUG_dumpNode(struct Node *node) {
-    printf("Node %p: T%d L%p R%p Tk%p A%p AC%zu EB%p LL%d RL%d\n", node, node->type, node->left, node->right,
-           node->token, node->args, node->argCount, node->elseBlock, node->leftLocation, node->rightLocation);
+    printf("Node %p: T%d L%p R%p Tk'%.*s' A%p AC%zu EB%p LL%d RL%d\n", node, node->type, node->left, node->right,
+           (int)node->token.length, node->token.start, node->args, node->argCount, node->elseBlock, node->leftLocation,
+           node->rightLocation);
 }
 
-struct TokenStack *sakuraX_newTokStack(void) {
+struct TokenStack *sakuraX_newTokStack(const char *source, int length) {
     struct TokenStack *stack = (struct TokenStack *)malloc(sizeof(struct TokenStack));
-    stack->tokens = (struct Token **)malloc(16 * sizeof(struct Token *));
-    stack->capacity = 16;
-    stack->size = 0;
+    if (stack == NULL) {
+        printf("Error: could not allocate memory for tokens\n");
+        exit(1);
+    }
+
+    sakuraX_initTokStack(stack, source, length);
     return stack;
 }
 
-void sakuraX_freeTokStack(struct TokenStack *stack) {
-    if (stack == NULL)
-        return;
+void sakuraX_initTokStack(struct TokenStack *stack, const char *source, int length) {
+    stack->source = source;
+    stack->length = length;
+    stack->position = 0;
+    stack->head = 0;
+    stack->count = 0;
+    stack->lexed = 0;
+    stack->quiet = 0;
+    stack->invalid = 0;
+}
 
-    if (stack->size > 0) {
-        for (ull i = 0; i < stack->size; i++) {
-            sakuraY_freeToken(stack->tokens[i]);
-        }
-    }
+void sakuraX_freeTokStack(struct TokenStack *stack) { free(stack); }
 
-    free(stack->tokens);
-    free(stack);
-}
+// lexes until the ring holds at least count tokens, returns 0 if the source runs out first
+int sakuraX_fillTokStack(struct TokenStack *stack, size_t count) {
+    while (stack->count < count) {
+        struct Token *tok = &stack->ring[(stack->head + stack->count) & (SAKURA_TOKEN_LOOKAHEAD - 1)];
+        if (!sakuraX_lexToken(stack, tok))
+            return 0;
 
-void sakuraX_pushTokStack(struct TokenStack *stack, struct Token *token) {
-    if (stack->size >= stack->capacity) {
-        stack->capacity *= 2;
-        stack->tokens = (struct Token **)realloc(stack->tokens, stack->capacity * sizeof(struct Token *));
+        stack->count++;
     }
-    stack->tokens[stack->size++] = token;
+
+    return 1;
 }
 
 struct Token *sakuraX_popTokStack(struct TokenStack *stack) {
     struct Token *token;
 
-    if (stack->size == 0) {
+    if (!sakuraX_fillTokStack(stack, 1)) {
         printf("Error: stack underflow while popping token\n");
         return NULL;
     }
 
-    token = stack->tokens[0];
-    for (ull i = 0; i < stack->size - 1; i++)
-        stack->tokens[i] = stack->tokens[i + 1];
-
-    stack->size--;
+    // the slot is only reused once the lexer wraps around to it, so the token outlives the pop
+    token = &stack->ring[stack->head];
+    stack->head = (stack->head + 1) & (SAKURA_TOKEN_LOOKAHEAD - 1);
+    stack->count--;
     return token;
 }
 
 struct Token *sakuraX_peekTokStack(struct TokenStack *stack, int silent) {
-    if (stack->size > 0) {
-        return stack->tokens[0];
+    if (sakuraX_fillTokStack(stack, 1)) {
+        return &stack->ring[stack->head];
     } else {
         if (!silent)
             printf("Error: stack underflow while peeking token\n");
@@ -87,57 +188,54 @@ struct Token *sakuraX_peekTokStack(struct TokenStack *stack, int silent) {
     }
 }
 
+struct Token *sakuraX_peekTokStackN(struct TokenStack *stack, size_t ahead) {
+    if (ahead >= SAKURA_TOKEN_LOOKAHEAD - 1) {
+        printf("Error: cannot look %zu tokens ahead\n", ahead);
+        return NULL;
+    }
+
+    if (!sakuraX_fillTokStack(stack, ahead + 1))
+        return NULL;
+
+    return &stack->ring[(stack->head + ahead) & (SAKURA_TOKEN_LOOKAHEAD - 1)];
+}
+
 struct Token *sakuraX_peekTokStack_s(struct TokenStack *stack) { return sakuraX_peekTokStack(stack, 0); }
 
-struct NodeStack *sakuraX_newNodeStack(void) {
-    struct NodeStack *stack = (struct NodeStack *)malloc(sizeof(struct NodeStack));
-    stack->nodes = (struct Node **)malloc(16 * sizeof(struct Node *));
+struct NodeStack *sakuraX_newNodeStack(struct NodeArena *arena) {
+    struct NodeStack *stack = (struct NodeStack *)sakuraX_allocNodeArena(arena, sizeof(struct NodeStack));
+    stack->nodes = (struct Node **)sakuraX_allocNodeArena(arena, 16 * sizeof(struct Node *));
     stack->capacity = 16;
     stack->size = 0;
+    stack->cursor = 0;
+    stack->arena = arena;
     return stack;
 }
 
-void sakuraX_freeNodeStack(struct NodeStack *stack) {
-    if (stack == NULL)
-        return;
-
-    if (stack->size > 0) {
-        for (ull i = 0; i < stack->size; i++) {
-            sakuraY_freeNode(stack->nodes[i]);
-        }
-    }
-
-    free(stack->nodes);
-    free(stack);
-}
-
 void sakuraX_pushNodeStack(struct NodeStack *stack, struct Node *node) {
     if (stack->size >= stack->capacity) {
+        struct Node **nodes =
+            (struct Node **)sakuraX_allocNodeArena(stack->arena, stack->capacity * 2 * sizeof(struct Node *));
+
+        memcpy(nodes, stack->nodes, stack->size * sizeof(struct Node *));
+        stack->nodes = nodes;
         stack->capacity *= 2;
-        stack->nodes = (struct Node **)realloc(stack->nodes, stack->capacity * sizeof(struct Node *));
     }
     stack->nodes[stack->size++] = node;
 }
 
 struct Node *sakuraX_popNodeStack(struct NodeStack *stack) {
-    struct Node *node;
-    if (stack->size == 0) {
+    if (stack->cursor >= stack->size) {
         printf("Error: stack underflow while popping node\n");
         return NULL;
     }
 
-    node = stack->nodes[0];
-    for (ull i = 0; i < stack->size - 1; i++) {
-        stack->nodes[i] = stack->nodes[i + 1];
-    }
-
-    stack->size--;
-    return node;
+    return stack->nodes[stack->cursor++];
 }
 
 struct Node *sakuraX_peekNodeStack(struct NodeStack *stack, int silent) {
-    if (stack->size > 0) {
-        return stack->nodes[0];
+    if (stack->cursor < stack->size) {
+        return stack->nodes[stack->cursor];
     } else {
         if (!silent)
             printf("Error: stack underflow while peeking node\n");
@@ -147,63 +245,50 @@ struct Node *sakuraX_peekNodeStack(struct NodeStack *stack, int silent) {
 
 struct Node *sakuraX_peekNodeStack_s(struct NodeStack *stack) { return sakuraX_peekNodeStack(stack, 0); }
 
-struct TokenStack *sakuraY_analyze(SakuraState *S, struct s_str *source) {
-    struct TokenStack *stack = sakuraX_newTokStack();
+int sakuraX_lexToken(struct TokenStack *stack, struct Token *tok) {
+    const char *str = stack->source;
+    int len = stack->length, i = stack->position;
 
-    LOG_CALL();
+    // loops only to skip over characters that don't start a token
+    while (1) {
+        unsigned char cls;
 
-    S->currentState = SAKURA_FLAG_LEXER;
+        // most runs of whitespace are a single space, only longer ones are worth handing to the scanner
+        if (i < len && (sakuraX_charClass[(unsigned char)str[i]] & SAKURA_CHAR_SPACE))
+            i = sakuraX_scanRun(str, i + 1, len, SAKURA_CHAR_SPACE);
 
-    for (int i = 0; i < source->len; i++) {
-        while (i < source->len && isspace(source->str[i]))
-            i++;
+        if (i >= len) {
+            stack->position = len;
+            return 0;
+        }
 
-        if (i >= source->len)
-            break;
+        tok->start = str + i;
+        tok->length = 1;
 
-        if (isdigit(source->str[i]) || source->str[i] == '.') {
-            struct Token *tok = (struct Token *)malloc(sizeof(struct Token));
+        cls = sakuraX_charClass[(unsigned char)str[i]];
+        if (cls & SAKURA_CHAR_NUMBER) {
             tok->type = SAKURA_TOKEN_NUMBER;
-            tok->start = source->str + i;
-            while (i < source->len && (isdigit(source->str[i]) || source->str[i] == '.'))
-                i++;
-
-            tok->length = i-- - (tok->start - source->str);
-            sakuraX_pushTokStack(stack, tok);
-        } else if (isalpha(source->str[i]) || source->str[i] == '_') {
-            struct Token *tok = (struct Token *)malloc(sizeof(struct Token));
+            i = sakuraX_scanRun(str, i + 1, len, SAKURA_CHAR_NUMBER);
+            tok->length = i - (tok->start - str);
+        } else if (cls & SAKURA_CHAR_ALPHA) {
             tok->type = SAKURA_TOKEN_IDENTIFIER;
-            tok->start = source->str + i;
-            while (i < source->len && (isalnum(source->str[i]) || source->str[i] == '_' || isdigit(source->str[i])))
-                i++;
-
-            tok->length = i-- - (tok->start - source->str);
-            sakuraX_pushTokStack(stack, tok);
-        } else if (source->str[i] == '"' || source->str[i] == '\'') {
-            struct Token *tok = (struct Token *)malloc(sizeof(struct Token));
-            char quoteChar;
+            i = sakuraX_scanRun(str, i + 1, len, SAKURA_CHAR_IDENT);
+            tok->length = i - (tok->start - str);
+        } else if (str[i] == '"' || str[i] == '\'') {
+            char quoteChar = str[i++];
 
             tok->type = SAKURA_TOKEN_STRING;
-            tok->start = source->str + i + 1;
-            quoteChar = source->str[i++];
+            tok->start = str + i;
 
-            while (i < source->len && source->str[i] != quoteChar) {
-                if (source->str[i] == '\\' && i + 1 < source->len) {
-                    // handle escape sequences
-                    i += 2;
-                } else {
-                    i++;
-                }
+            // the scanner stops on the closing quote or on an escape, which skips the escaped character
+            while ((i = sakuraX_scanQuote(str, i, len, quoteChar)) < len && str[i] == '\\') {
+                i += i + 1 < len ? 2 : 1;
             }
 
-            tok->length = i - (tok->start - source->str);
-            sakuraX_pushTokStack(stack, tok);
+            tok->length = i - (tok->start - str);
+            i++; // closing quote
         } else {
-            struct Token *tok = (struct Token *)malloc(sizeof(struct Token));
-            tok->start = source->str + i;
-            tok->length = 1;
-
-            switch (source->str[i]) {
+            switch (str[i]) {
             case '+':
                 tok->type = SAKURA_TOKEN_PLUS;
                 break;
@@ -253,55 +338,89 @@ struct TokenStack *sakuraY_analyze(SakuraState *S, struct s_str *source) {
                 tok->type = SAKURA_TOKEN_HASHTAG;
                 break;
             case '!':
-                if (i + 1 < source->len && source->str[i + 1] == '=') {
+                if (i + 1 < len && str[i + 1] == '=') {
                     tok->type = SAKURA_TOKEN_BANG_EQUAL;
+                    tok->length = 2;
                     break;
                 }
                 tok->type = SAKURA_TOKEN_BANG;
                 break;
             case '=':
-                if (i + 1 < source->len && source->str[i + 1] == '=') {
+                if (i + 1 < len && str[i + 1] == '=') {
                     tok->type = SAKURA_TOKEN_EQUAL_EQUAL;
+                    tok->length = 2;
                     break;
                 }
                 tok->type = SAKURA_TOKEN_EQUAL;
                 break;
             case '>':
-                if (i + 1 < source->len && source->str[i + 1] == '=') {
+                if (i + 1 < len && str[i + 1] == '=') {
                     tok->type = SAKURA_TOKEN_GREATER_EQUAL;
+                    tok->length = 2;
                     break;
                 }
                 tok->type = SAKURA_TOKEN_GREATER;
                 break;
             case '<':
-                if (i + 1 < source->len && source->str[i + 1] == '=') {
+                if (i + 1 < len && str[i + 1] == '=') {
                     tok->type = SAKURA_TOKEN_LESS_EQUAL;
+                    tok->length = 2;
                     break;
                 }
                 tok->type = SAKURA_TOKEN_LESS;
                 break;
             case '&':
-                if (i + 1 < source->len && source->str[i + 1] == '&') {
+                if (i + 1 < len && str[i + 1] == '&') {
                     tok->type = SAKURA_TOKEN_AND;
+                    tok->length = 2;
                     break;
                 }
-                printf("Error: unexpected character '&', expected '&&'\n");
-                break;
+                if (!stack->quiet)
+                    printf("Error: unexpected character '&', expected '&&'\n");
+                stack->invalid++;
+                i++;
+                continue;
             case '|':
-                if (i + 1 < source->len && source->str[i + 1] == '|') {
+                if (i + 1 < len && str[i + 1] == '|') {
                     tok->type = SAKURA_TOKEN_OR;
+                    tok->length = 2;
                     break;
                 }
-                printf("Error: unexpected character '|', expected '||'\n");
-                break;
+                if (!stack->quiet)
+                    printf("Error: unexpected character '|', expected '||'\n");
+                stack->invalid++;
+                i++;
+                continue;
             default:
-                printf("Error: unexpected character '%c'\n", source->str[i]);
-                break;
+                if (!stack->quiet)
+                    printf("Error: unexpected character '%c'\n", str[i]);
+                stack->invalid++;
+                i++;
+                continue;
             }
 
-            sakuraX_pushTokStack(stack, tok);
+
+            i += (int)tok->length;
         }
+
+        stack->position = i;
+        stack->lexed++;
+        return 1;
     }
+}
+
+struct TokenStack *sakuraY_analyze(SakuraState *S, struct s_str *source) {
+    struct TokenStack *stack;
+
+    LOG_CALL();
+
+    S->currentState = SAKURA_FLAG_LEXER;
+
+    if (sakuraX_scanClass == NULL)
+        sakuraX_initLexer();
+
+    // nothing is lexed yet, the parser pulls tokens out of the stack as it needs them
+    stack = sakuraX_newTokStack(source->str, source->len);
 
     LOG_POP();
     return stack;
@@ -316,7 +435,7 @@ struct Node *sakuraX_parseUnary(SakuraState *S, struct Token *token, struct Node
 
     if (left->type == SAKURA_TOKEN_NUMBER) {
         if (token->type == SAKURA_TOKEN_MINUS) {
-            left->storageValue = -left->storageValue;
+            sakuraX_negateNumber(&left->storageValue);
         } else if (token->type == SAKURA_TOKEN_PLUS) {
             ; // do nothing
         } else {
@@ -327,110 +446,199 @@ struct Node *sakuraX_parseUnary(SakuraState *S, struct Token *token, struct Node
         return left;
     }
 
-    node = sakuraX_makeNode(SAKURA_NODE_UNARY_OPERATION);
+    node = sakuraX_makeNode(S, SAKURA_NODE_UNARY_OPERATION);
     node->left = left;
-    node->token = token;
+    node->token = *token;
 
     LOG_POP();
     return node;
 }
 
-struct Node *sakuraX_binaryOperation(SakuraState *S, struct TokenStack *tokens, enum TokenType types[],
-                                     struct Node *(*fn)(SakuraState *, struct TokenStack *)) {
-    struct Node *left, *right, *newNode;
-    int hasType = 0;
+// binding power of each binary operator, 0 for tokens that don't continue an expression
+const unsigned char sakuraX_bindingPower[SAKURA_TOKEN_SENTINEL] = {
+    [SAKURA_TOKEN_AND] = 1,
+    [SAKURA_TOKEN_OR] = 1,
+    [SAKURA_TOKEN_EQUAL_EQUAL] = 2,
+    [SAKURA_TOKEN_BANG_EQUAL] = 2,
+    [SAKURA_TOKEN_GREATER] = 2,
+    [SAKURA_TOKEN_GREATER_EQUAL] = 2,
+    [SAKURA_TOKEN_LESS] = 2,
+    [SAKURA_TOKEN_LESS_EQUAL] = 2,
+    [SAKURA_TOKEN_PLUS] = 3,
+    [SAKURA_TOKEN_MINUS] = 3,
+    [SAKURA_TOKEN_STAR] = 4,
+    [SAKURA_TOKEN_SLASH] = 4,
+    [SAKURA_TOKEN_PERCENT] = 4,
+    [SAKURA_TOKEN_CARET] = 5,
+};
+
+struct SakuraNumber sakuraX_parseNumber(const struct Token *token) {
+    struct SakuraNumber number;
+    char buffer[64], *tokStr = buffer;
+    unsigned long long value = 0;
+    size_t i;
+
+    // a literal without a dot is an integer, unless it's too large for one
+    for (i = 0; i < token->length && token->start[i] != '.'; i++) {
+        if (value > (9223372036854775807ULL - (unsigned long long)(token->start[i] - '0')) / 10)
+            break;
+        value = value * 10 + (unsigned long long)(token->start[i] - '0');
+    }
 
-    LOG_CALL();
+    if (i == token->length) {
+        number.isInteger = 1;
+        number.i = (long long)value;
+        number.n = 0;
+        return number;
+    }
 
-    left = fn(S, tokens);
-    while (1) {
-        struct Token *token = sakuraX_peekTokStack(tokens, 1);
-        if (token == NULL)
-            break;
+    // strtod needs a terminated copy, only absurdly long literals need the heap for it
+    if (token->length >= sizeof(buffer))
+        tokStr = (char *)malloc(token->length + 1);
+    memcpy(tokStr, token->start, token->length);
+    tokStr[token->length] = '\0';
+    number.isInteger = 0;
+    number.i = 0;
+    number.n = strtod(tokStr, NULL);
+    if (tokStr != buffer)
+        free(tokStr);
 
-        hasType = 0;
-        for (ull i = 0; types[i] != SAKURA_TOKEN_SENTINEL; i++) {
-            if (token->type == types[i]) {
-                if (sakuraX_popTokStack(tokens) == NULL) {
-                    S->error = SAKURA_EFLAG_SYNTAX;
-                    sakuraY_freeToken(token);
-                    printf("Error: could not pop token from stack\n");
-                    LOG_POP();
-                    return NULL;
-                }
+    return number;
+}
 
-                right = fn(S, tokens);
+void sakuraX_negateNumber(struct SakuraNumber *number) {
+    if (number->isInteger)
+        number->i = TV_INTARITH(0, -, number->i);
+    else
+        number->n = -number->n;
+}
 
-                if (left->type == SAKURA_TOKEN_NUMBER && right->type == SAKURA_TOKEN_NUMBER) {
-                    int exitV = 0;
-                    switch (token->type) {
-                    case SAKURA_TOKEN_PLUS:
-                        left->storageValue += right->storageValue;
-                        break;
-                    case SAKURA_TOKEN_MINUS:
-                        left->storageValue -= right->storageValue;
-                        break;
-                    case SAKURA_TOKEN_STAR:
-                        left->storageValue *= right->storageValue;
-                        break;
-                    case SAKURA_TOKEN_SLASH:
-                        left->storageValue /= right->storageValue;
-                        break;
-                    case SAKURA_TOKEN_CARET:
-                        left->storageValue = pow(left->storageValue, right->storageValue);
-                        break;
-                    case SAKURA_TOKEN_PERCENT:
-                        left->storageValue = fmod(left->storageValue, right->storageValue);
-                        break;
-                    case SAKURA_TOKEN_LESS:
-                        left->storageValue = left->storageValue < right->storageValue ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_LESS_EQUAL:
-                        left->storageValue = left->storageValue <= right->storageValue ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_GREATER:
-                        left->storageValue = left->storageValue > right->storageValue ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_GREATER_EQUAL:
-                        left->storageValue = left->storageValue >= right->storageValue ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_EQUAL_EQUAL:
-                        left->storageValue = left->storageValue == right->storageValue ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_BANG_EQUAL:
-                        left->storageValue = left->storageValue != right->storageValue ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_AND:
-                        left->storageValue = left->storageValue == 1 && right->storageValue == 1 ? 1 : 0;
-                        break;
-                    case SAKURA_TOKEN_OR:
-                        left->storageValue = left->storageValue == 1 || right->storageValue == 1 ? 1 : 0;
-                        break;
-                    default:
-                        exitV = 1;
-                        break;
-                    }
+// folds with the semantics the vm gives the operation, so a folded constant has the subtype the instruction would have
+// produced. integers stay integers through + - * %, everything else works on floats
+int sakuraX_foldBinary(enum TokenType op, struct SakuraNumber *left, const struct SakuraNumber *right) {
+    int integers = left->isInteger && right->isInteger;
+    double x = SAKURA_NUMBER_FLOAT(*left), y = SAKURA_NUMBER_FLOAT(*right);
+    TValue a, b;
+
+    switch (op) {
+    case SAKURA_TOKEN_PLUS:
+        if (integers)
+            left->i = TV_INTARITH(left->i, +, right->i);
+        else
+            left->n = x + y;
+        break;
+    case SAKURA_TOKEN_MINUS:
+        if (integers)
+            left->i = TV_INTARITH(left->i, -, right->i);
+        else
+            left->n = x - y;
+        break;
+    case SAKURA_TOKEN_STAR:
+        if (integers)
+            left->i = TV_INTARITH(left->i, *, right->i);
+        else
+            left->n = x * y;
+        break;
+    case SAKURA_TOKEN_SLASH:
+        integers = 0;
+        left->n = x / y;
+        break;
+    case SAKURA_TOKEN_CARET:
+        integers = 0;
+        left->n = pow(x, y);
+        break;
+    case SAKURA_TOKEN_PERCENT:
+        // an integer modulo by zero is left for the vm to report
+        if (integers && right->i == 0)
+            return 0;
+        if (integers)
+            left->i = sakuraX_modInteger(left->i, right->i);
+        else
+            left->n = sakuraX_modFloat(x, y);
+        break;
+    case SAKURA_TOKEN_LESS:
+        left->i = integers ? left->i < right->i : x < y;
+        integers = 1;
+        break;
+    case SAKURA_TOKEN_LESS_EQUAL:
+        left->i = integers ? left->i <= right->i : x <= y;
+        integers = 1;
+        break;
+    case SAKURA_TOKEN_GREATER:
+        left->i = integers ? left->i > right->i : x > y;
+        integers = 1;
+        break;
+    case SAKURA_TOKEN_GREATER_EQUAL:
+        left->i = integers ? left->i >= right->i : x >= y;
+        integers = 1;
+        break;
+    case SAKURA_TOKEN_EQUAL_EQUAL:
+    case SAKURA_TOKEN_BANG_EQUAL:
+        a = left->isInteger ? sakuraY_makeTInteger(left->i) : sakuraY_makeTNumber(left->n);
+        b = right->isInteger ? sakuraY_makeTInteger(right->i) : sakuraY_makeTNumber(right->n);
+        left->i = sakuraX_compareTValues(&a, &b) == (op == SAKURA_TOKEN_EQUAL_EQUAL);
+        integers = 1;
+        break;
+    case SAKURA_TOKEN_AND:
+        left->i = x == 1 && y == 1 ? 1 : 0;
+        integers = 1;
+        break;
+    case SAKURA_TOKEN_OR:
+        left->i = x == 1 || y == 1 ? 1 : 0;
+        integers = 1;
+        break;
+    default:
+        return 0;
+    }
 
-                    if (exitV == 0) {
-                        sakuraY_freeToken(token);
-                        sakuraY_freeNode(right);
-                        hasType = 1;
-                        break;
-                    }
-                }
+    left->isInteger = integers;
+    return 1;
+}
 
-                newNode = sakuraX_makeNode(SAKURA_NODE_BINARY_OPERATION);
-                newNode->left = left;
-                newNode->right = right;
-                newNode->token = token;
-                left = newNode;
-                hasType = 1;
-                break;
-            }
+struct Node *sakuraX_makeBinary(SakuraState *S, const struct Token *op, struct Node *left, struct Node *right) {
+    struct Node *node;
+
+    // operations on two number literals are folded into the left literal
+    if (left->type == SAKURA_TOKEN_NUMBER && right->type == SAKURA_TOKEN_NUMBER &&
+        sakuraX_foldBinary(op->type, &left->storageValue, &right->storageValue))
+        return left;
+
+    node = sakuraX_makeNode(S, SAKURA_NODE_BINARY_OPERATION);
+    node->left = left;
+    node->right = right;
+    node->token = *op;
+    return node;
+}
+
+struct Node *sakuraX_parseBinary(SakuraState *S, struct TokenStack *tokens, int minPower) {
+    struct Node *left, *right;
+    struct Token *token, op;
+    int power;
+
+    LOG_CALL();
+
+    left = sakuraX_parseFactor(S, tokens);
+    if (left == NULL) {
+        LOG_POP();
+        return NULL;
+    }
+
+    // every operator is left associative, so the right side only takes operators that bind tighter
+    while ((token = sakuraX_peekTokStack(tokens, 1)) != NULL &&
+           (power = sakuraX_bindingPower[token->type]) > minPower) {
+        // the right side pulls more tokens through the lexer, so the operator has to be copied out first
+        op = *token;
+        sakuraX_popTokStack(tokens);
+
+        right = sakuraX_parseBinary(S, tokens, power);
+        if (right == NULL) {
+            S->error = SAKURA_EFLAG_SYNTAX;
+            printf("Error: expected an expression after '%.*s'\n", (int)op.length, op.start);
+            LOG_POP();
+            return NULL;
         }
 
-        if (hasType == 0)
-            break;
+        left = sakuraX_makeBinary(S, &op, left, right);
     }
 
     LOG_POP();
@@ -444,175 +652,109 @@ struct Node *sakuraX_parseFactor(SakuraState *S, struct TokenStack *tokens) {
 
     token = sakuraX_popTokStack(tokens);
     if (token->type == SAKURA_TOKEN_NUMBER) {
-        struct Node *node = sakuraX_makeNode(SAKURA_TOKEN_NUMBER);
-        char *tokStr;
-
-        node->token = token;
-
-        tokStr = (char *)malloc(token->length + 1);
-        memcpy(tokStr, token->start, token->length);
-        tokStr[token->length] = '\0';
-        node->storageValue = strtod(tokStr, NULL);
-        free(tokStr);
+        struct Node *node = sakuraX_makeNode(S, SAKURA_TOKEN_NUMBER);
+        node->token = *token;
+        node->storageValue = sakuraX_parseNumber(token);
 
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_STRING) {
-        struct Node *node = sakuraX_makeNode(SAKURA_TOKEN_STRING);
-        node->token = token;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_TOKEN_STRING);
+        node->token = *token;
         LOG_POP();
         return node;
-    } else if (token->type == SAKURA_TOKEN_BANG) {
-        struct Node *op = sakuraX_parseUnary(S, token, sakuraX_parseFactor(S, tokens));
+    } else if (token->type == SAKURA_TOKEN_BANG || token->type == SAKURA_TOKEN_HASHTAG) {
+        struct Token unary = *token;
+        struct Node *op = sakuraX_parseUnary(S, &unary, sakuraX_parseFactor(S, tokens));
         LOG_POP();
         return op;
     } else if (token->type == SAKURA_TOKEN_PLUS || token->type == SAKURA_TOKEN_MINUS) {
-        struct Node *op = sakuraX_parseUnary(S, token, sakuraX_parseFactor(S, tokens));
+        struct Token unary = *token;
+        struct Node *op = sakuraX_parseUnary(S, &unary, sakuraX_parseFactor(S, tokens));
         LOG_POP();
         return op;
     } else if (token->type == SAKURA_TOKEN_LEFT_BRACE) {
         // parse table
-        struct Node *node = sakuraX_makeNode(SAKURA_NODE_TABLE);
-        sakuraY_freeToken(token);
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_TABLE);
 
         while ((token = sakuraX_peekTokStack(tokens, 1))->type != SAKURA_TOKEN_RIGHT_BRACE) {
             struct Node *key = NULL, *value = NULL;
             if (token->type == SAKURA_TOKEN_LEFT_SQUARE) {
                 // get key
-                sakuraY_freeToken(sakuraX_popTokStack(tokens));
+                sakuraX_popTokStack(tokens);
                 key = sakuraX_parseExpressionEntry(S, tokens);
                 if (key == NULL) {
                     printf("Error: could not parse key\n");
-                    sakuraY_freeNode(node);
                     LOG_POP();
                     return NULL;
                 }
 
                 if (sakuraX_peekTokStack(tokens, 1)->type != SAKURA_TOKEN_RIGHT_SQUARE) {
                     printf("Error: expected ']'\n");
-                    sakuraY_freeNode(node);
-                    sakuraY_freeNode(key);
-                    sakuraY_freeToken(token);
                     LOG_POP();
                     return NULL;
                 }
 
-                sakuraY_freeToken(sakuraX_popTokStack(tokens));
+                sakuraX_popTokStack(tokens);
 
                 if (sakuraX_peekTokStack(tokens, 1)->type != SAKURA_TOKEN_EQUAL) {
                     printf("Error: expected '='\n");
-                    sakuraY_freeNode(node);
-                    sakuraY_freeNode(key);
-                    sakuraY_freeToken(token);
                     LOG_POP();
                     return NULL;
                 }
 
-                sakuraY_freeToken(sakuraX_popTokStack(tokens));
+                sakuraX_popTokStack(tokens);
             }
 
             value = sakuraX_parseExpressionEntry(S, tokens);
-            node->keys = (struct Node **)realloc(node->keys, (node->argCount + 1) * sizeof(struct Node *));
-            node->args = (struct Node **)realloc(node->args, (node->argCount + 1) * sizeof(struct Node *));
-            node->keys[node->argCount] = key;
-            node->args[node->argCount++] = value;
+            sakuraX_addNodeArg(S, node, key, value);
 
             if (sakuraX_peekTokStack(tokens, 1)->type == SAKURA_TOKEN_COMMA) {
-                sakuraY_freeToken(sakuraX_popTokStack(tokens));
+                sakuraX_popTokStack(tokens);
                 continue;
             } else {
                 if (sakuraX_peekTokStack(tokens, 1)->type == SAKURA_TOKEN_RIGHT_BRACE) {
-                    sakuraY_freeToken(sakuraX_popTokStack(tokens));
                     break;
                 } else {
                     printf("Error: expected ',' or '}', got '%.*s' (%d)\n",
                            (int)sakuraX_peekTokStack(tokens, 1)->length, sakuraX_peekTokStack(tokens, 1)->start,
                            sakuraX_peekTokStack(tokens, 1)->type);
-                    sakuraY_freeNode(node);
-                    sakuraY_freeToken(token);
                     LOG_POP();
                     return NULL;
                 }
             }
         }
 
+        // closing brace, also reached directly for an empty table
+        sakuraX_popTokStack(tokens);
+
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_LEFT_PAREN) {
         struct Node *node = sakuraX_parseExpressionEntry(S, tokens);
-        sakuraY_freeToken(token);
         token = sakuraX_popTokStack(tokens);
         if (token->type != SAKURA_TOKEN_RIGHT_PAREN) {
             printf("Error: expected ')'\n");
-            sakuraY_freeNode(node);
-            sakuraY_freeToken(token);
             LOG_POP();
             return NULL;
         }
 
-        sakuraY_freeToken(token);
+        node = sakuraX_parsePostfix(S, node, tokens);
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_IDENTIFIER) {
-        struct Node *node = sakuraX_makeNode(SAKURA_TOKEN_IDENTIFIER);
-        node->token = token;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_TOKEN_IDENTIFIER);
+        node->token = *token;
+        node = sakuraX_parsePostfix(S, node, tokens);
         LOG_POP();
         return node;
     } else {
         printf("Error: unexpected token '%.*s' while factoring\n", (int)token->length, token->start);
-        sakuraY_freeToken(token);
         LOG_POP();
         return NULL;
     }
 }
 
-struct Node *sakuraX_parseAtom(SakuraState *S, struct TokenStack *tokens) {
-    enum TokenType ops[] = {SAKURA_TOKEN_CARET, SAKURA_TOKEN_SENTINEL};
-    struct Node *node;
-    LOG_CALL();
-    node = sakuraX_binaryOperation(S, tokens, ops, sakuraX_parseFactor);
-    LOG_POP();
-    return node;
-}
-
-struct Node *sakuraX_parseTerm(SakuraState *S, struct TokenStack *tokens) {
-    enum TokenType ops[] = {SAKURA_TOKEN_STAR, SAKURA_TOKEN_SLASH, SAKURA_TOKEN_PERCENT, SAKURA_TOKEN_SENTINEL};
-    struct Node *node;
-    LOG_CALL();
-    node = sakuraX_binaryOperation(S, tokens, ops, sakuraX_parseAtom);
-    LOG_POP();
-    return node;
-}
-
-struct Node *sakuraX_parseExpression(SakuraState *S, struct TokenStack *tokens) {
-    enum TokenType ops[] = {SAKURA_TOKEN_PLUS, SAKURA_TOKEN_MINUS, SAKURA_TOKEN_SENTINEL};
-    struct Node *node;
-    LOG_CALL();
-    node = sakuraX_binaryOperation(S, tokens, ops, sakuraX_parseTerm);
-    LOG_POP();
-    return node;
-}
-
-struct Node *sakuraX_parseComparisons(SakuraState *S, struct TokenStack *tokens) {
-    enum TokenType ops[] = {SAKURA_TOKEN_EQUAL_EQUAL, SAKURA_TOKEN_BANG_EQUAL, SAKURA_TOKEN_GREATER,
-                            SAKURA_TOKEN_GREATER_EQUAL, SAKURA_TOKEN_LESS, SAKURA_TOKEN_LESS_EQUAL,
-                            SAKURA_TOKEN_SENTINEL};
-    struct Node *node;
-    LOG_CALL();
-    node = sakuraX_binaryOperation(S, tokens, ops, sakuraX_parseExpression);
-    LOG_POP();
-    return node;
-}
-
-struct Node *sakuraX_parseLogical(SakuraState *S, struct TokenStack *tokens) {
-    enum TokenType ops[] = {SAKURA_TOKEN_AND, SAKURA_TOKEN_OR, SAKURA_TOKEN_SENTINEL};
-    struct Node *node;
-    LOG_CALL();
-    node = sakuraX_binaryOperation(S, tokens, ops, sakuraX_parseComparisons);
-    LOG_POP();
-    return node;
-}
-
 struct Node *sakuraX_parseVar(SakuraState *S, struct TokenStack *tokens) {
     struct Token *token;
     struct Node *node;
@@ -624,33 +766,27 @@ struct Node *sakuraX_parseVar(SakuraState *S, struct TokenStack *tokens) {
         struct Token *name, *equal;
         struct Node *value;
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
         name = sakuraX_popTokStack(tokens);
         if (name == NULL || name->type != SAKURA_TOKEN_IDENTIFIER) {
             printf("Error: expected identifier\n");
-            sakuraY_freeToken(name);
             LOG_POP();
             return NULL;
         }
 
-        node = sakuraX_makeNode(SAKURA_NODE_VAR);
-        node->token = name;
+        node = sakuraX_makeNode(S, SAKURA_NODE_VAR);
+        node->token = *name;
 
         equal = sakuraX_popTokStack(tokens);
         if (equal == NULL || equal->type != SAKURA_TOKEN_EQUAL) {
             printf("Error: expected '='\n");
-            sakuraY_freeToken(equal);
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
 
-        sakuraY_freeToken(equal);
-
         value = sakuraX_parseExpressionEntry(S, tokens);
         if (value == NULL) {
             printf("Error: could not parse value\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -660,7 +796,7 @@ struct Node *sakuraX_parseVar(SakuraState *S, struct TokenStack *tokens) {
         return node;
     }
 
-    node = sakuraX_parseLogical(S, tokens);
+    node = sakuraX_parseBinary(S, tokens, 0);
     LOG_POP();
     return node;
 }
@@ -681,14 +817,13 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
 
     token = sakuraX_peekTokStack(tokens, 1);
     if (token->type == SAKURA_TOKEN_IDENTIFIER && str_cmp_cl(token->start, token->length, "if") == 0) {
-        struct Node *node = sakuraX_makeNode(SAKURA_NODE_IF), *condition, *block;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_IF), *condition, *block;
         struct Token *elseToken;
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
         condition = sakuraX_parseExpressionEntry(S, tokens);
         if (condition == NULL) {
             printf("Error: could not parse condition\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -698,7 +833,6 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
         block = sakuraX_parseBlocks(S, tokens);
         if (block == NULL) {
             printf("Error: could not parse block\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -710,11 +844,10 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
             str_cmp_cl(elseToken->start, elseToken->length, "else") == 0) {
             struct Node *elseBlock;
 
-            sakuraY_freeToken(sakuraX_popTokStack(tokens));
+            sakuraX_popTokStack(tokens);
             elseBlock = sakuraX_parseBlocks(S, tokens);
             if (elseBlock == NULL) {
                 printf("Error: could not parse else block\n");
-                sakuraY_freeNode(node);
                 LOG_POP();
                 return NULL;
             }
@@ -727,13 +860,12 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_IDENTIFIER && str_cmp_cl(token->start, token->length, "while") == 0) {
-        struct Node *node = sakuraX_makeNode(SAKURA_NODE_WHILE), *condition, *block;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_WHILE), *condition, *block;
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
         condition = sakuraX_parseExpressionEntry(S, tokens);
         if (condition == NULL) {
             printf("Error: could not parse condition\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -743,7 +875,6 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
         block = sakuraX_parseBlocks(S, tokens);
         if (block == NULL) {
             printf("Error: could not parse block\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -753,15 +884,14 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_IDENTIFIER && str_cmp_cl(token->start, token->length, "loop") == 0) {
-        struct Node *node = sakuraX_makeNode(SAKURA_NODE_WHILE), *block;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_WHILE), *block;
         node->left = NULL;
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
 
         block = sakuraX_parseBlocks(S, tokens);
         if (block == NULL) {
             printf("Error: could not parse block\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -771,63 +901,51 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_IDENTIFIER && str_cmp_cl(token->start, token->length, "fn") == 0) {
-        struct Node *node = sakuraX_makeNode(SAKURA_NODE_FUNCTION), *block;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_FUNCTION), *block;
         struct Token *name, *leftParen, *arg, *comma;
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
         name = sakuraX_popTokStack(tokens);
         if (name == NULL || name->type != SAKURA_TOKEN_IDENTIFIER) {
             printf("Error: expected identifier, got %d\n", name->type);
-            sakuraY_freeToken(name);
             LOG_POP();
             return NULL;
         }
 
-        node->token = name;
+        node->token = *name;
 
         leftParen = sakuraX_popTokStack(tokens);
         if (leftParen == NULL || leftParen->type != SAKURA_TOKEN_LEFT_PAREN) {
             printf("Error: expected '('\n");
-            sakuraY_freeToken(leftParen);
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
 
-        sakuraY_freeToken(leftParen);
-
         while (1) {
             arg = sakuraX_popTokStack(tokens);
             if (arg != NULL && arg->type == SAKURA_TOKEN_IDENTIFIER) {
-                node->args = (struct Node **)realloc(node->args, (node->argCount + 1) * sizeof(struct Node *));
-                node->args[node->argCount++] = sakuraX_makeNode(SAKURA_TOKEN_IDENTIFIER);
-                node->args[node->argCount - 1]->token = arg;
+                struct Node *param = sakuraX_makeNode(S, SAKURA_TOKEN_IDENTIFIER);
+                param->token = *arg;
+                sakuraX_addNodeArg(S, node, NULL, param);
 
                 comma = sakuraX_popTokStack(tokens);
                 if (comma != NULL && comma->type == SAKURA_TOKEN_COMMA) {
-                    sakuraY_freeToken(comma);
                     continue;
                 } else {
                     if (comma != NULL && comma->type == SAKURA_TOKEN_RIGHT_PAREN) {
-                        sakuraY_freeToken(comma);
                         break;
                     } else {
                         printf("Error: expected ',' or ')'\n");
-                        sakuraY_freeNode(node);
-                        sakuraY_freeToken(comma);
                         LOG_POP();
                         return NULL;
                     }
                 }
             } else {
                 if (arg->type == SAKURA_TOKEN_RIGHT_PAREN) {
-                    sakuraY_freeToken(arg);
                     break;
                 }
 
                 printf("Error: expected identifier\n");
-                sakuraY_freeNode(node);
-                sakuraY_freeToken(arg);
                 LOG_POP();
                 return NULL;
             }
@@ -836,34 +954,50 @@ struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens) {
         block = sakuraX_parseBlocks(S, tokens);
         if (block == NULL) {
             printf("Error: could not parse block\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
 
         node->left = block;
 
+        LOG_POP();
+        return node;
+    } else if (token->type == SAKURA_TOKEN_IDENTIFIER && str_cmp_cl(token->start, token->length, "return") == 0) {
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_RETURN);
+        struct Token *next;
+
+        sakuraX_popTokStack(tokens);
+
+        // a return at the end of a block or the source has no value
+        next = sakuraX_peekTokStack(tokens, 1);
+        if (next != NULL && next->type != SAKURA_TOKEN_RIGHT_BRACE) {
+            node->left = sakuraX_parseExpressionEntry(S, tokens);
+            if (node->left == NULL) {
+                printf("Error: could not parse return value\n");
+                LOG_POP();
+                return NULL;
+            }
+        }
+
         LOG_POP();
         return node;
     } else if (token->type == SAKURA_TOKEN_LEFT_BRACE) {
-        struct Node *node = sakuraX_makeNode(SAKURA_NODE_BLOCK), *block;
+        struct Node *node = sakuraX_makeNode(S, SAKURA_NODE_BLOCK), *block;
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
 
         while (sakuraX_peekTokStack_s(tokens)->type != SAKURA_TOKEN_RIGHT_BRACE) {
             block = sakuraX_parseBlocks(S, tokens);
             if (block != NULL) {
-                node->args = (struct Node **)realloc(node->args, (node->argCount + 1) * sizeof(struct Node *));
-                node->args[node->argCount++] = block;
+                sakuraX_addNodeArg(S, node, NULL, block);
             } else {
                 printf("Error: could not parse block\n");
-                sakuraY_freeNode(node);
                 LOG_POP();
                 return NULL;
             }
         }
 
-        sakuraY_freeToken(sakuraX_popTokStack(tokens));
+        sakuraX_popTokStack(tokens);
 
         LOG_POP();
         return node;
@@ -883,31 +1017,26 @@ struct Node *sakuraX_parseCall(SakuraState *S, struct Node *prev, struct TokenSt
 
     LOG_CALL();
 
-    node = sakuraX_makeNode(SAKURA_NODE_CALL);
+    node = sakuraX_makeNode(S, SAKURA_NODE_CALL);
     node->left = prev;
 
-    sakuraY_freeToken(sakuraX_popTokStack(tokens));
+    sakuraX_popTokStack(tokens);
     while (sakuraX_peekTokStack(tokens, 1)->type != SAKURA_TOKEN_RIGHT_PAREN) {
         struct Node *arg = sakuraX_parseExpressionEntry(S, tokens);
         if (arg != NULL) {
             struct Token *comma;
 
-            node->args = (struct Node **)realloc(node->args, (node->argCount + 1) * sizeof(struct Node *));
-            node->args[node->argCount++] = arg;
+            sakuraX_addNodeArg(S, node, NULL, arg);
 
             comma = sakuraX_popTokStack(tokens);
             if (comma != NULL && comma->type == SAKURA_TOKEN_COMMA) {
-                sakuraY_freeToken(comma);
                 continue;
             } else {
                 if (comma != NULL && comma->type == SAKURA_TOKEN_RIGHT_PAREN) {
                     hasRparen = 1;
-                    sakuraY_freeToken(comma);
                     break;
                 } else {
                     printf("Error: expected ',' or ')'\n");
-                    sakuraY_freeNode(node);
-                    sakuraY_freeToken(comma);
                     LOG_POP();
                     return NULL;
                 }
@@ -916,7 +1045,6 @@ struct Node *sakuraX_parseCall(SakuraState *S, struct Node *prev, struct TokenSt
             break;
         } else {
             printf("Error: could not parse argument\n");
-            sakuraY_freeNode(node);
             LOG_POP();
             return NULL;
         }
@@ -926,13 +1054,10 @@ struct Node *sakuraX_parseCall(SakuraState *S, struct Node *prev, struct TokenSt
         struct Token *rightParen = sakuraX_popTokStack(tokens);
         if (rightParen == NULL || rightParen->type != SAKURA_TOKEN_RIGHT_PAREN) {
             printf("Error: expected ')'\n");
-            sakuraY_freeNode(node);
-            sakuraY_freeToken(rightParen);
             LOG_POP();
             return NULL;
         }
 
-        sakuraY_freeToken(rightParen);
     }
 
     peeked = sakuraX_peekTokStack(tokens, 1);
@@ -954,15 +1079,14 @@ struct Node *sakuraX_parseIndex(SakuraState *S, struct Node *prev, struct TokenS
 
     LOG_CALL();
 
-    node = sakuraX_makeNode(SAKURA_NODE_INDEX);
+    node = sakuraX_makeNode(S, SAKURA_NODE_INDEX);
     node->left = prev;
 
-    sakuraY_freeToken(sakuraX_popTokStack(tokens));
+    sakuraX_popTokStack(tokens);
     idx = sakuraX_parseExpressionEntry(S, tokens);
 
     if (idx == NULL) {
         printf("Error: could not parse index\n");
-        sakuraY_freeNode(node);
         LOG_POP();
         return NULL;
     }
@@ -971,12 +1095,11 @@ struct Node *sakuraX_parseIndex(SakuraState *S, struct Node *prev, struct TokenS
 
     if (sakuraX_peekTokStack_s(tokens)->type != SAKURA_TOKEN_RIGHT_SQUARE) {
         printf("Error: expected ']'\n");
-        sakuraY_freeNode(node);
         LOG_POP();
         return NULL;
     }
 
-    sakuraY_freeToken(sakuraX_popTokStack(tokens));
+    sakuraX_popTokStack(tokens);
 
     peeked = sakuraX_peekTokStack(tokens, 1);
     if (peeked != NULL && peeked->type == SAKURA_TOKEN_LEFT_PAREN) {
@@ -991,6 +1114,26 @@ struct Node *sakuraX_parseIndex(SakuraState *S, struct Node *prev, struct TokenS
     return node;
 }
 
+struct Node *sakuraX_parsePostfix(SakuraState *S, struct Node *prev, struct TokenStack *tokens) {
+    struct Token *peeked;
+
+    LOG_CALL();
+
+    peeked = sakuraX_peekTokStack(tokens, 1);
+    if (peeked != NULL && peeked->type == SAKURA_TOKEN_LEFT_PAREN) {
+        // call operator
+        LOG_POP();
+        return sakuraX_parseCall(S, prev, tokens);
+    } else if (peeked != NULL && peeked->type == SAKURA_TOKEN_LEFT_SQUARE) {
+        // index operator
+        LOG_POP();
+        return sakuraX_parseIndex(S, prev, tokens);
+    }
+
+    LOG_POP();
+    return prev;
+}
+
 struct Node *sakuraX_parseExecution(SakuraState *S, struct TokenStack *tokens) {
     struct Node *block;
     struct Token *nextToken;
@@ -1020,17 +1163,17 @@ struct NodeStack *sakuraY_parse(SakuraState *S, struct TokenStack *tokens) {
 
     LOG_CALL();
 
-    stack = sakuraX_newNodeStack();
+    stack = sakuraX_newNodeStack(&S->nodeArena);
     S->currentState = SAKURA_FLAG_PARSER;
 
-    while (tokens->size > 0) {
+    while (sakuraX_peekTokStack(tokens, 1) != NULL) {
         node = sakuraX_parseExecution(S, tokens);
 
         if (node != NULL) {
             sakuraX_pushNodeStack(stack, node);
         } else {
+            // whatever was parsed goes away with the arena
             printf("Error: could not parse expression\n");
-            sakuraX_freeNodeStack(stack);
             stack = NULL;
             break;
         }
@@ -1038,52 +1181,4 @@ struct NodeStack *sakuraY_parse(SakuraState *S, struct TokenStack *tokens) {
 
     LOG_POP();
     return stack;
-}
-
-void sakuraY_freeToken(struct Token *token) {
-    LOG_CALL();
-
-    free(token);
-    token = NULL;
-
-    LOG_POP();
-}
-
-void sakuraY_freeNode(struct Node *node) {
-    LOG_CALL();
-
-    if (node->left != NULL) {
-        sakuraY_freeNode(node->left);
-        node->left = NULL;
-    }
-
-    if (node->right != NULL) {
-        sakuraY_freeNode(node->right);
-        node->right = NULL;
-    }
-
-    if (node->token != NULL) {
-        sakuraY_freeToken(node->token);
-        node->token = NULL;
-    }
-
-    if (node->args != NULL) {
-        if (node->argCount > 0) {
-            for (ull i = 0; i < node->argCount; i++) {
-                sakuraY_freeNode(node->args[i]);
-            }
-        }
-        free(node->args);
-        node->args = NULL;
-    }
-
-    if (node->elseBlock != NULL) {
-        sakuraY_freeNode(node->elseBlock);
-        node->elseBlock = NULL;
-    }
-
-    free(node);
-    node = NULL;
-
-    LOG_POP();
 }
\ No newline at end of file
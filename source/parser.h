@@ -3,18 +3,24 @@
 #include "sakura.h"
 #include "sstr.h"
 
-struct Node *sakuraX_makeNode(enum TokenType type);
+void *sakuraX_allocNodeArena(struct NodeArena *arena, size_t size);
+void sakuraX_resetNodeArena(struct NodeArena *arena);
+void sakuraX_freeNodeArena(struct NodeArena *arena);
+struct Node *sakuraX_makeNode(SakuraState *S, enum TokenType type);
+void sakuraX_addNodeArg(SakuraState *S, struct Node *node, struct Node *key, struct Node *arg);
 void sakuraDEBUG_dumpNode(struct Node *node);
 
-struct TokenStack *sakuraX_newTokStack(void);
+struct TokenStack *sakuraX_newTokStack(const char *source, int length);
+void sakuraX_initTokStack(struct TokenStack *stack, const char *source, int length);
 void sakuraX_freeTokStack(struct TokenStack *stack);
-void sakuraX_pushTokStack(struct TokenStack *stack, struct Token *token);
+int sakuraX_lexToken(struct TokenStack *stack, struct Token *tok);
+int sakuraX_fillTokStack(struct TokenStack *stack, size_t count);
 struct Token *sakuraX_popTokStack(struct TokenStack *stack);
 struct Token *sakuraX_peekTokStack(struct TokenStack *stack, int silent);
 struct Token *sakuraX_peekTokStack_s(struct TokenStack *stack);
+struct Token *sakuraX_peekTokStackN(struct TokenStack *stack, size_t ahead);
 
-struct NodeStack *sakuraX_newNodeStack(void);
-void sakuraX_freeNodeStack(struct NodeStack *stack);
+struct NodeStack *sakuraX_newNodeStack(struct NodeArena *arena);
 void sakuraX_pushNodeStack(struct NodeStack *stack, struct Node *node);
 struct Node *sakuraX_popNodeStack(struct NodeStack *stack);
 struct Node *sakuraX_peekNodeStack(struct NodeStack *stack, int silent);
@@ -23,22 +29,20 @@ struct Node *sakuraX_peekNodeStack_s(struct NodeStack *stack);
 struct TokenStack *sakuraY_analyze(SakuraState *S, struct s_str *source);
 struct NodeStack *sakuraY_parse(SakuraState *S, struct TokenStack *tokens);
 
-void sakuraY_freeToken(struct Token *token);
-void sakuraY_freeNode(struct Node *node);
+extern const unsigned char sakuraX_bindingPower[SAKURA_TOKEN_SENTINEL];
 
 struct Node *sakuraX_parseUnary(SakuraState *S, struct Token *token, struct Node *left);
-struct Node *sakuraX_binaryOperation(SakuraState *S, struct TokenStack *tokens, enum TokenType types[],
-                                     struct Node *(*fn)(SakuraState *, struct TokenStack *));
+struct SakuraNumber sakuraX_parseNumber(const struct Token *token);
+void sakuraX_negateNumber(struct SakuraNumber *number);
+int sakuraX_foldBinary(enum TokenType op, struct SakuraNumber *left, const struct SakuraNumber *right);
+struct Node *sakuraX_makeBinary(SakuraState *S, const struct Token *op, struct Node *left, struct Node *right);
+struct Node *sakuraX_parseBinary(SakuraState *S, struct TokenStack *tokens, int minPower);
 struct Node *sakuraX_parseFactor(SakuraState *S, struct TokenStack *tokens);
-struct Node *sakuraX_parseTerm(SakuraState *S, struct TokenStack *tokens);
-struct Node *sakuraX_parseAtom(SakuraState *S, struct TokenStack *tokens);
-struct Node *sakuraX_parseExpression(SakuraState *S, struct TokenStack *tokens);
-struct Node *sakuraX_parseComparisons(SakuraState *S, struct TokenStack *tokens);
-struct Node *sakuraX_parseLogical(SakuraState *S, struct TokenStack *tokens);
 struct Node *sakuraX_parseVar(SakuraState *S, struct TokenStack *tokens);
 struct Node *sakuraX_parseExpressionEntry(SakuraState *S, struct TokenStack *tokens);
 struct Node *sakuraX_parseBlocks(SakuraState *S, struct TokenStack *tokens);
 struct Node *sakuraX_parseExecution(SakuraState *S, struct TokenStack *tokens);
 
 struct Node *sakuraX_parseCall(SakuraState *S, struct Node *prev, struct TokenStack *tokens);
-struct Node *sakuraX_parseIndex(SakuraState *S, struct Node *prev, struct TokenStack *tokens);
\ No newline at end of file
+struct Node *sakuraX_parseIndex(SakuraState *S, struct Node *prev, struct TokenStack *tokens);
+struct Node *sakuraX_parsePostfix(SakuraState *S, struct Node *prev, struct TokenStack *tokens);
\ No newline at end of file
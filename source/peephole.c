@@ -0,0 +1,699 @@
+#include "peephole.h"
+#include "typeinfer.h"
+
+#include <stdlib.h>
+
+// names used by the disassembler, in the order of enum SakuraPeepholeRule
+const char *sakuraX_peepholeRuleName(int rule) {
+    static const char *const names[SAKURA_PEEPHOLE_RULE_COUNT] = {
+        "move-self",    "jump-next",     "jump-chain",  "not-equal", "move-result",
+        "move-operand", "compare-jump", "const-operand", "global-call", "typed",
+    };
+    return names[rule];
+}
+
+void sakuraX_optimizeAssembly(struct SakuraAssembly *assembly) {
+#ifdef SAKURA_NO_PEEPHOLE
+    UNUSED(assembly);
+#else
+    for (ull i = 0; i < assembly->closureIdx; i++)
+        sakuraX_optimizeAssembly(assembly->closures[i]);
+
+    sakuraX_peephole(assembly);
+#endif
+}
+
+void sakuraX_peephole(struct SakuraAssembly *assembly) {
+    struct SakuraPeephole P;
+    ull hits;
+
+    LOG_CALL();
+
+    sakuraX_peepholeLoad(&P, assembly);
+
+    // a rule can open up a match for another one, so they run until none of them changes anything
+    do {
+        hits = sakuraX_peepholeJumpChain(&P);
+        hits += sakuraX_peepholeMoveSelf(&P);
+        hits += sakuraX_peepholeNotEqual(&P);
+        hits += sakuraX_peepholeMoveOperand(&P);
+        hits += sakuraX_peepholeMoveResult(&P);
+        hits += sakuraX_peepholeJumpNext(&P);
+        hits += sakuraX_peepholeCompareBranch(&P);
+        hits += sakuraX_peepholeConstOperand(&P);
+        hits += sakuraX_peepholeGlobalCall(&P);
+    } while (hits > 0);
+
+    // typing runs once the code stopped changing, the rules above only know the untyped opcodes
+    sakuraX_inferTypes(&P);
+
+    sakuraX_peepholeWrite(&P);
+    sakuraX_peepholeFree(&P);
+
+    LOG_POP();
+}
+
+// forward jumps that ended up out of reach of their packed operand are only correct once the code is written again,
+// this runs on every function whatever the build does with the rules
+void sakuraX_widenJumps(struct SakuraAssembly *assembly) {
+    struct SakuraPeephole P;
+
+    if (assembly->farJumpCount == 0)
+        return;
+
+    sakuraX_peepholeLoad(&P, assembly);
+    sakuraX_peepholeWrite(&P);
+    sakuraX_peepholeFree(&P);
+}
+
+void sakuraX_peepholeLoad(struct SakuraPeephole *P, struct SakuraAssembly *assembly) {
+    ull *index;
+
+    P->assembly = assembly;
+    P->code = (struct SakuraInstruction *)malloc((assembly->size + 1) * sizeof(struct SakuraInstruction));
+    P->count = 0;
+
+    // word offset -> instruction index, one past the end so a jump to the end of the code maps too
+    index = (ull *)malloc((assembly->size + 1) * sizeof(ull));
+    for (ull pc = 0; pc < assembly->size; pc += P->code[P->count - 1].size) {
+        index[pc] = P->count;
+        sakuraX_decodeInstruction(assembly, pc, &P->code[P->count++]);
+    }
+    index[assembly->size] = P->count;
+
+    // the targets set aside by SakuraAssembly_patchBx replace the placeholder left in the packed jump
+    for (ull i = 0; i < assembly->farJumpCount; i += 2)
+        P->code[index[assembly->farJumps[i]]].bx = (int)assembly->farJumps[i + 1];
+    assembly->farJumpCount = 0;
+
+    for (ull k = 0; k < P->count; k++)
+        if (P->code[k].op == SAKURA_JMP || P->code[k].op == SAKURA_JMPIF)
+            P->code[k].bx = (int)index[P->code[k].bx];
+    free(index);
+
+    P->removed = (char *)calloc(P->count + 1, sizeof(char));
+    P->label = (char *)calloc(P->count + 1, sizeof(char));
+}
+
+void sakuraX_peepholeFree(struct SakuraPeephole *P) {
+    free(P->code);
+    free(P->removed);
+    free(P->label);
+}
+
+// the first instruction at or after k that's still in the code
+ull sakuraX_peepholeResolve(const struct SakuraPeephole *P, ull k) {
+    while (k < P->count && P->removed[k])
+        k++;
+    return k;
+}
+
+void sakuraX_peepholeMarkLabels(struct SakuraPeephole *P) {
+    memset(P->label, 0, P->count + 1);
+    for (ull k = 0; k < P->count; k++) {
+        if (P->removed[k])
+            continue;
+        if (P->code[k].op == SAKURA_JMP || P->code[k].op == SAKURA_JMPIF)
+            P->label[sakuraX_peepholeResolve(P, (ull)P->code[k].bx)] = 1;
+    }
+}
+
+// whether ins may read reg, opcodes the pass doesn't know about read everything
+int sakuraX_peepholeReads(const struct SakuraInstruction *ins, int reg) {
+    switch (ins->op) {
+    case SAKURA_LOADK:
+    case SAKURA_LOADNIL:
+    case SAKURA_GETGLOBAL:
+    case SAKURA_CLOSURE:
+    case SAKURA_NEWTABLE:
+    case SAKURA_JMP:
+        return 0;
+    case SAKURA_MOVE:
+    case SAKURA_UNM:
+    case SAKURA_NOT:
+    case SAKURA_LENTBL:
+    case SAKURA_ADDK:
+    case SAKURA_SUBK:
+    case SAKURA_MULK:
+    case SAKURA_TADDKI:
+    case SAKURA_TSUBKI:
+    case SAKURA_TMULKI:
+    case SAKURA_TADDKF:
+    case SAKURA_TSUBKF:
+    case SAKURA_TMULKF:
+        return ins->b == reg;
+    case SAKURA_ADD:
+    case SAKURA_SUB:
+    case SAKURA_MUL:
+    case SAKURA_DIV:
+    case SAKURA_MOD:
+    case SAKURA_POW:
+    case SAKURA_EQ:
+    case SAKURA_NE:
+    case SAKURA_LT:
+    case SAKURA_LE:
+    case SAKURA_GETTABLE:
+    case SAKURA_LTJMP:
+    case SAKURA_LEJMP:
+    case SAKURA_EQJMP:
+    case SAKURA_NEJMP:
+    case SAKURA_TADDI:
+    case SAKURA_TSUBI:
+    case SAKURA_TMULI:
+    case SAKURA_TADDF:
+    case SAKURA_TSUBF:
+    case SAKURA_TMULF:
+    case SAKURA_TDIVF:
+    case SAKURA_TLTJMPI:
+    case SAKURA_TLEJMPI:
+    case SAKURA_TLTJMPF:
+    case SAKURA_TLEJMPF:
+        return ins->b == reg || ins->c == reg;
+    case SAKURA_SETTABLE:
+        return ins->a == reg || ins->b == reg || ins->c == reg;
+    case SAKURA_SETGLOBAL:
+    case SAKURA_JMPIF:
+        return ins->a == reg;
+    case SAKURA_CALL:
+    case SAKURA_TAILCALL:
+        return reg >= ins->a && reg <= ins->a + ins->b;
+    case SAKURA_CALLGLOBAL:
+        return reg > ins->a && reg <= ins->a + ins->b;
+    case SAKURA_RETURN:
+        return reg >= ins->a && reg < ins->a + ins->b;
+    default:
+        return 1;
+    }
+}
+
+// whether ins overwrites reg, a call clobbers every register from the function up since the callee's frame starts there
+int sakuraX_peepholeWrites(const struct SakuraInstruction *ins, int reg) {
+    switch (ins->op) {
+    case SAKURA_MOVE:
+    case SAKURA_LOADK:
+    case SAKURA_GETGLOBAL:
+    case SAKURA_CLOSURE:
+    case SAKURA_NEWTABLE:
+    case SAKURA_ADD:
+    case SAKURA_SUB:
+    case SAKURA_MUL:
+    case SAKURA_DIV:
+    case SAKURA_MOD:
+    case SAKURA_POW:
+    case SAKURA_UNM:
+    case SAKURA_EQ:
+    case SAKURA_NE:
+    case SAKURA_LT:
+    case SAKURA_LE:
+    case SAKURA_NOT:
+    case SAKURA_LENTBL:
+    case SAKURA_GETTABLE:
+    case SAKURA_ADDK:
+    case SAKURA_SUBK:
+    case SAKURA_MULK:
+    case SAKURA_TADDI:
+    case SAKURA_TSUBI:
+    case SAKURA_TMULI:
+    case SAKURA_TADDKI:
+    case SAKURA_TSUBKI:
+    case SAKURA_TMULKI:
+    case SAKURA_TADDF:
+    case SAKURA_TSUBF:
+    case SAKURA_TMULF:
+    case SAKURA_TDIVF:
+    case SAKURA_TADDKF:
+    case SAKURA_TSUBKF:
+    case SAKURA_TMULKF:
+        return ins->a == reg;
+    case SAKURA_LOADNIL:
+        return reg >= ins->a && reg <= ins->a + ins->b;
+    case SAKURA_CALL:
+    case SAKURA_CALLGLOBAL:
+        return reg >= ins->a;
+    default:
+        return 0;
+    }
+}
+
+// instructions that only write register a, from registers in b and c, so their result and operands can be renamed.
+// the constant operand of addk, subk and mulk is negative and never matches a register
+int sakuraX_peepholePure(const struct SakuraInstruction *ins) {
+    switch (ins->op) {
+    case SAKURA_LOADNIL:
+        return ins->b == 0;
+    case SAKURA_MOVE:
+    case SAKURA_LOADK:
+    case SAKURA_GETGLOBAL:
+    case SAKURA_CLOSURE:
+    case SAKURA_NEWTABLE:
+    case SAKURA_ADD:
+    case SAKURA_SUB:
+    case SAKURA_MUL:
+    case SAKURA_DIV:
+    case SAKURA_MOD:
+    case SAKURA_POW:
+    case SAKURA_UNM:
+    case SAKURA_EQ:
+    case SAKURA_NE:
+    case SAKURA_LT:
+    case SAKURA_LE:
+    case SAKURA_NOT:
+    case SAKURA_LENTBL:
+    case SAKURA_GETTABLE:
+    case SAKURA_ADDK:
+    case SAKURA_SUBK:
+    case SAKURA_MULK:
+    case SAKURA_TADDI:
+    case SAKURA_TSUBI:
+    case SAKURA_TMULI:
+    case SAKURA_TADDKI:
+    case SAKURA_TSUBKI:
+    case SAKURA_TMULKI:
+    case SAKURA_TADDF:
+    case SAKURA_TSUBF:
+    case SAKURA_TMULF:
+    case SAKURA_TDIVF:
+    case SAKURA_TADDKF:
+    case SAKURA_TSUBKF:
+    case SAKURA_TMULKF:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// whether the value in reg is never read again when execution reaches k. both ways out of a branch are followed and
+// the scan assumes the register is read once it runs out of budget
+int sakuraX_peepholeIsDead(const struct SakuraPeephole *P, ull k, int reg, int *budget) {
+    while (k < P->count) {
+        const struct SakuraInstruction *ins = &P->code[k];
+
+        if (P->removed[k]) {
+            k++;
+            continue;
+        }
+
+        if (--*budget < 0 || sakuraX_peepholeReads(ins, reg))
+            return 0;
+
+        switch (ins->op) {
+        case SAKURA_JMP:
+            k = (ull)ins->bx;
+            continue;
+        case SAKURA_JMPIF:
+            if (!sakuraX_peepholeIsDead(P, (ull)ins->bx, reg, budget))
+                return 0;
+            break;
+        case SAKURA_LTJMP:
+        case SAKURA_LEJMP:
+        case SAKURA_EQJMP:
+        case SAKURA_NEJMP:
+        case SAKURA_TLTJMPI:
+        case SAKURA_TLEJMPI:
+        case SAKURA_TLTJMPF:
+        case SAKURA_TLEJMPF:
+            // the comparison holding skips the jmp, failing goes on to it
+            k = sakuraX_peepholeResolve(P, k + 1);
+            if (!sakuraX_peepholeIsDead(P, k + 1, reg, budget))
+                return 0;
+            continue;
+        case SAKURA_RETURN:
+        case SAKURA_TAILCALL:
+            return 1;
+        }
+
+        if (sakuraX_peepholeWrites(ins, reg))
+            return 1;
+        k++;
+    }
+
+    return 1;
+}
+
+ull sakuraX_peepholeMoveSelf(struct SakuraPeephole *P) {
+    ull hits = 0;
+
+    for (ull k = 0; k < P->count; k++) {
+        if (!P->removed[k] && P->code[k].op == SAKURA_MOVE && P->code[k].a == P->code[k].b) {
+            P->removed[k] = 1;
+            hits++;
+        }
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_MOVE_SELF] += hits;
+    return hits;
+}
+
+ull sakuraX_peepholeJumpNext(struct SakuraPeephole *P) {
+    ull hits = 0;
+    int paired = 0;
+
+    for (ull k = 0; k < P->count; k++) {
+        if (P->removed[k])
+            continue;
+
+        // the jmp after a compare-and-branch is part of it
+        if (P->code[k].op == SAKURA_JMP && !paired &&
+            sakuraX_peepholeResolve(P, (ull)P->code[k].bx) == sakuraX_peepholeResolve(P, k + 1)) {
+            P->removed[k] = 1;
+            hits++;
+        }
+
+        paired = sakuraX_peepholeCompareJump(P->code[k].op);
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_JUMP_NEXT] += hits;
+    return hits;
+}
+
+ull sakuraX_peepholeJumpChain(struct SakuraPeephole *P) {
+    ull hits = 0, target, first;
+    int hops;
+
+    for (ull k = 0; k < P->count; k++) {
+        if (P->removed[k] || (P->code[k].op != SAKURA_JMP && P->code[k].op != SAKURA_JMPIF))
+            continue;
+
+        first = target = sakuraX_peepholeResolve(P, (ull)P->code[k].bx);
+
+        for (hops = 0; hops < 8 && target < P->count && P->code[target].op == SAKURA_JMP && target != k; hops++)
+            target = sakuraX_peepholeResolve(P, (ull)P->code[target].bx);
+
+        // a loop of jumps never settles, a chain still going after the hop limit is left alone
+        if (hops == 8 && target < P->count && P->code[target].op == SAKURA_JMP && target != k)
+            continue;
+
+        if (target != first) {
+            P->code[k].bx = (int)target;
+            hits++;
+        }
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_JUMP_CHAIN] += hits;
+    return hits;
+}
+
+ull sakuraX_peepholeNotEqual(struct SakuraPeephole *P) {
+    ull hits = 0, next;
+
+    sakuraX_peepholeMarkLabels(P);
+
+    for (ull k = 0; k < P->count; k++) {
+        struct SakuraInstruction *eq = &P->code[k], *negate;
+
+        if (P->removed[k] || eq->op != SAKURA_EQ)
+            continue;
+
+        next = sakuraX_peepholeResolve(P, k + 1);
+        if (next >= P->count || P->label[next])
+            continue;
+
+        negate = &P->code[next];
+        if (negate->op == SAKURA_NOT && negate->a == eq->a && negate->b == eq->a) {
+            eq->op = SAKURA_NE;
+            P->removed[next] = 1;
+            hits++;
+        }
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_NOT_EQUAL] += hits;
+    return hits;
+}
+
+// op t, b, c followed by mov x, t writes x directly when t isn't read afterwards
+ull sakuraX_peepholeMoveResult(struct SakuraPeephole *P) {
+    ull hits = 0, next;
+    int budget;
+
+    sakuraX_peepholeMarkLabels(P);
+
+    for (ull k = 0; k < P->count; k++) {
+        struct SakuraInstruction *op = &P->code[k], *move;
+
+        if (P->removed[k] || !sakuraX_peepholePure(op))
+            continue;
+
+        next = sakuraX_peepholeResolve(P, k + 1);
+        if (next >= P->count || P->label[next])
+            continue;
+
+        move = &P->code[next];
+        if (move->op != SAKURA_MOVE || move->b != op->a || move->a == op->a)
+            continue;
+
+        budget = SAKURA_PEEPHOLE_SCAN;
+        if (!sakuraX_peepholeIsDead(P, next + 1, op->a, &budget))
+            continue;
+
+        op->a = move->a;
+        P->removed[next] = 1;
+        hits++;
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_MOVE_RESULT] += hits;
+    return hits;
+}
+
+// mov t, x followed shortly by an operation reading t reads x instead, as long as neither register changes in between
+// and t isn't read afterwards
+ull sakuraX_peepholeMoveOperand(struct SakuraPeephole *P) {
+    ull hits = 0, j;
+    int t, x, budget, steps;
+
+    sakuraX_peepholeMarkLabels(P);
+
+    for (ull k = 0; k < P->count; k++) {
+        struct SakuraInstruction *use;
+
+        if (P->removed[k] || P->code[k].op != SAKURA_MOVE || P->code[k].a == P->code[k].b)
+            continue;
+
+        t = P->code[k].a;
+        x = P->code[k].b;
+
+        for (j = sakuraX_peepholeResolve(P, k + 1), steps = 0; j < P->count && steps < SAKURA_PEEPHOLE_WINDOW;
+             j = sakuraX_peepholeResolve(P, j + 1), steps++) {
+            use = &P->code[j];
+
+            // anything but straight line code between the copy and its use stops the search
+            if (P->label[j] ||
+                (!sakuraX_peepholePure(use) && use->op != SAKURA_SETGLOBAL && use->op != SAKURA_SETTABLE))
+                break;
+
+            if (sakuraX_peepholeReads(use, t)) {
+                budget = SAKURA_PEEPHOLE_SCAN;
+                if (!sakuraX_peepholePure(use) ||
+                    (!sakuraX_peepholeWrites(use, t) && !sakuraX_peepholeIsDead(P, j + 1, t, &budget)))
+                    break;
+
+                if (use->b == t)
+                    use->b = x;
+                if (use->c == t)
+                    use->c = x;
+                P->removed[k] = 1;
+                hits++;
+                break;
+            }
+
+            if (sakuraX_peepholeWrites(use, t) || sakuraX_peepholeWrites(use, x))
+                break;
+        }
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_MOVE_OPERAND] += hits;
+    return hits;
+}
+
+int sakuraX_peepholeCompareJump(int op) {
+    return op == SAKURA_LTJMP || op == SAKURA_LEJMP || op == SAKURA_EQJMP || op == SAKURA_NEJMP ||
+           (op >= SAKURA_TLTJMPI && op <= SAKURA_TLEJMPF);
+}
+
+// lt/le/eq/ne t, b, c followed by jmpif t becomes the compare-and-branch version followed by a jmp, when t isn't read
+// on either side of the branch
+ull sakuraX_peepholeCompareBranch(struct SakuraPeephole *P) {
+    ull hits = 0, next;
+    int budget, op;
+
+    sakuraX_peepholeMarkLabels(P);
+
+    for (ull k = 0; k < P->count; k++) {
+        struct SakuraInstruction *compare = &P->code[k], *jump;
+
+        if (P->removed[k])
+            continue;
+
+        switch (compare->op) {
+        case SAKURA_LT:
+            op = SAKURA_LTJMP;
+            break;
+        case SAKURA_LE:
+            op = SAKURA_LEJMP;
+            break;
+        case SAKURA_EQ:
+            op = SAKURA_EQJMP;
+            break;
+        case SAKURA_NE:
+            op = SAKURA_NEJMP;
+            break;
+        default:
+            continue;
+        }
+
+        next = sakuraX_peepholeResolve(P, k + 1);
+        if (next >= P->count || P->label[next])
+            continue;
+
+        jump = &P->code[next];
+        if (jump->op != SAKURA_JMPIF || jump->a != compare->a)
+            continue;
+
+        budget = SAKURA_PEEPHOLE_SCAN;
+        if (!sakuraX_peepholeIsDead(P, next + 1, compare->a, &budget) ||
+            !sakuraX_peepholeIsDead(P, (ull)jump->bx, compare->a, &budget))
+            continue;
+
+        compare->op = op;
+        compare->a = 0;
+        jump->op = SAKURA_JMP;
+        jump->a = 0;
+        hits++;
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_COMPARE_JUMP] += hits;
+    return hits;
+}
+
+// loadk t, k followed by an operation reading t as its right operand reads k from the pool instead. add, sub and mul
+// turn into their constant versions, compare-and-branch takes constants for either operand
+ull sakuraX_peepholeConstOperand(struct SakuraPeephole *P) {
+    ull hits = 0, next;
+    int t, budget;
+
+    sakuraX_peepholeMarkLabels(P);
+
+    for (ull k = 0; k < P->count; k++) {
+        struct SakuraInstruction *use, saved;
+
+        if (P->removed[k] || P->code[k].op != SAKURA_LOADK)
+            continue;
+
+        next = sakuraX_peepholeResolve(P, k + 1);
+        if (next >= P->count || P->label[next])
+            continue;
+
+        t = P->code[k].a;
+        use = &P->code[next];
+        saved = *use;
+
+        if ((use->op == SAKURA_ADD || use->op == SAKURA_SUB || use->op == SAKURA_MUL) && use->c == t && use->b != t) {
+            use->op = use->op == SAKURA_ADD ? SAKURA_ADDK : use->op == SAKURA_SUB ? SAKURA_SUBK : SAKURA_MULK;
+            use->c = P->code[k].bx;
+        } else if (sakuraX_peepholeCompareJump(use->op) && (use->b == t) != (use->c == t)) {
+            if (use->b == t)
+                use->b = P->code[k].bx;
+            else
+                use->c = P->code[k].bx;
+        } else {
+            continue;
+        }
+
+        // the operation doesn't read t anymore, so the load can go if nothing after it does either
+        budget = SAKURA_PEEPHOLE_SCAN;
+        if (!sakuraX_peepholeIsDead(P, next, t, &budget)) {
+            *use = saved;
+            continue;
+        }
+
+        P->removed[k] = 1;
+        hits++;
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_CONST_OPERAND] += hits;
+    return hits;
+}
+
+// getglobal f, slot followed by the argument setup of call f, n loads the function in the call. the setup can't touch
+// f or run anything that could change the global
+ull sakuraX_peepholeGlobalCall(struct SakuraPeephole *P) {
+    ull hits = 0, j;
+    int f;
+
+    sakuraX_peepholeMarkLabels(P);
+
+    for (ull k = 0; k < P->count; k++) {
+        if (P->removed[k] || P->code[k].op != SAKURA_GETGLOBAL)
+            continue;
+
+        f = P->code[k].a;
+        for (j = sakuraX_peepholeResolve(P, k + 1); j < P->count && !P->label[j];
+             j = sakuraX_peepholeResolve(P, j + 1)) {
+            struct SakuraInstruction *use = &P->code[j];
+
+            if (use->op == SAKURA_CALL && use->a == f) {
+                use->op = SAKURA_CALLGLOBAL;
+                use->c = P->code[k].bx;
+                P->removed[k] = 1;
+                hits++;
+                break;
+            }
+
+            if (!sakuraX_peepholePure(use) || sakuraX_peepholeReads(use, f) || sakuraX_peepholeWrites(use, f))
+                break;
+        }
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_GLOBAL_CALL] += hits;
+    return hits;
+}
+
+// lays the kept instructions out again and turns jump targets back into word offsets. a jump that moves further than
+// its packed operand reaches grows to the wide form, which can push other targets out, so sizes are settled first
+void sakuraX_peepholeWrite(struct SakuraPeephole *P) {
+    struct SakuraInstruction ins;
+    ull *pos;
+    int *size, changed;
+
+    pos = (ull *)malloc((P->count + 1) * sizeof(ull));
+    size = (int *)malloc((P->count + 1) * sizeof(int));
+
+    for (ull k = 0; k < P->count; k++) {
+        ins = P->code[k];
+        if (ins.op == SAKURA_JMP || ins.op == SAKURA_JMPIF)
+            ins.bx = 0;
+        size[k] = P->removed[k] ? 0 : sakuraX_instructionSize(&ins);
+    }
+
+    do {
+        pos[0] = 0;
+        for (ull k = 0; k < P->count; k++)
+            pos[k + 1] = pos[k] + (ull)size[k];
+
+        changed = 0;
+        for (ull k = 0; k < P->count; k++) {
+            ins = P->code[k];
+            if (P->removed[k] || (ins.op != SAKURA_JMP && ins.op != SAKURA_JMPIF))
+                continue;
+
+            ins.bx = (int)pos[ins.bx];
+            if (sakuraX_instructionSize(&ins) > size[k]) {
+                size[k] = sakuraX_instructionSize(&ins);
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    P->assembly->size = 0;
+    for (ull k = 0; k < P->count; k++) {
+        if (P->removed[k])
+            continue;
+
+        ins = P->code[k];
+        if (ins.op == SAKURA_JMP || ins.op == SAKURA_JMPIF)
+            ins.bx = (int)pos[ins.bx];
+        SakuraAssembly_pushInstruction(P->assembly, &ins);
+    }
+
+    free(pos);
+    free(size);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "assembler.h"
+
+// the peephole pass works on the decoded instructions of one assembly and writes them back once no rule matches.
+// while it runs jump targets are held as instruction indices instead of word offsets, so dropping an instruction
+// never has to patch the jumps around it
+struct SakuraPeephole {
+    struct SakuraAssembly *assembly;
+    struct SakuraInstruction *code;
+    ull count;
+    char *removed; // instructions dropped by a rule, a jump to one lands on the next instruction that's kept
+    char *label;   // instructions some jump lands on, code can only be merged across them when it's the first one
+};
+
+// instructions the liveness scan looks at before it gives up and assumes a register is still read
+#define SAKURA_PEEPHOLE_SCAN 32
+// instructions between a copy into a temporary and the operation reading it
+#define SAKURA_PEEPHOLE_WINDOW 4
+
+void sakuraX_optimizeAssembly(struct SakuraAssembly *assembly);
+void sakuraX_peephole(struct SakuraAssembly *assembly);
+void sakuraX_widenJumps(struct SakuraAssembly *assembly);
+void sakuraX_peepholeLoad(struct SakuraPeephole *P, struct SakuraAssembly *assembly);
+void sakuraX_peepholeFree(struct SakuraPeephole *P);
+const char *sakuraX_peepholeRuleName(int rule);
+
+ull sakuraX_peepholeResolve(const struct SakuraPeephole *P, ull k);
+void sakuraX_peepholeMarkLabels(struct SakuraPeephole *P);
+int sakuraX_peepholeReads(const struct SakuraInstruction *ins, int reg);
+int sakuraX_peepholeWrites(const struct SakuraInstruction *ins, int reg);
+int sakuraX_peepholePure(const struct SakuraInstruction *ins);
+int sakuraX_peepholeIsDead(const struct SakuraPeephole *P, ull k, int reg, int *budget);
+int sakuraX_peepholeCompareJump(int op);
+void sakuraX_peepholeWrite(struct SakuraPeephole *P);
+
+// rules, each returns how many times it matched
+ull sakuraX_peepholeMoveSelf(struct SakuraPeephole *P);
+ull sakuraX_peepholeJumpNext(struct SakuraPeephole *P);
+ull sakuraX_peepholeJumpChain(struct SakuraPeephole *P);
+ull sakuraX_peepholeNotEqual(struct SakuraPeephole *P);
+ull sakuraX_peepholeMoveResult(struct SakuraPeephole *P);
+ull sakuraX_peepholeMoveOperand(struct SakuraPeephole *P);
+ull sakuraX_peepholeCompareBranch(struct SakuraPeephole *P);
+ull sakuraX_peepholeConstOperand(struct SakuraPeephole *P);
+ull sakuraX_peepholeGlobalCall(struct SakuraPeephole *P);
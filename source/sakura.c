@@ -1,16 +1,13 @@
 #include "sakura.h"
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "assembler.h"
 #include "stable.h"
 
-unsigned int sakuraX_hashForTVMap(const char *key, ull len, ull capacity) {
-    unsigned int hashValue = 5381;
-    for (ull i = 0; i < len; i++)
-        hashValue = (hashValue << 5) + hashValue + key[i];
-    return hashValue % capacity;
-}
+uint32_t sakuraX_hashForTVMap(const char *key, ull len) { return (uint32_t)sakuraX_hashBytes(key, len, 0); }
 
 SakuraState *sakura_createState(void) {
     SakuraState *state = (SakuraState *)malloc(sizeof(SakuraState));
@@ -19,40 +16,31 @@ SakuraState *sakura_createState(void) {
         state->currentState = SAKURA_FLAG_ENDED;
         state->error = SAKURA_EFLAG_NONE;
 
-        state->pool.size = 0;
-        state->pool.capacity = 8;
-        state->pool.constants = (TValue *)malloc(state->pool.capacity * sizeof(TValue));
-
-        state->callStack = (int *)malloc(128 * sizeof(int));
+        state->callStack = (struct SakuraCallFrame *)malloc(128 * sizeof(struct SakuraCallFrame));
         state->callStackSize = 128;
         state->callStackIndex = 0;
 
-        state->locals = (struct s_str *)malloc(128 * sizeof(struct s_str));
-        state->localsSize = 128;
-
-        for (ull i = 0; i < state->localsSize; i++) {
-            state->locals[i].str = NULL;
-            state->locals[i].len = 0;
-        }
+        state->locals.symbols = NULL;
+        state->locals.size = 0;
+        state->locals.capacity = 0;
+        state->locals.index = NULL;
+        state->locals.indexCapacity = 0;
 
         sakuraX_initializeTVMap(&state->globals, 16);
+        state->nodeArena.blocks = NULL;
+
+        state->chunks = NULL;
+        state->chunkCount = 0;
+        state->chunkCapacity = 0;
 
         // initialize registry
-        state->registry.rax.tt = SAKURA_TNUMFLT;
-        state->registry.rax.value.n = 0;
-        state->registry.rbx.tt = SAKURA_TNUMFLT;
-        state->registry.rbx.value.n = 0;
-        state->registry.rcx.tt = SAKURA_TNUMFLT;
-        state->registry.rcx.value.n = 0;
-        state->registry.rdx.tt = SAKURA_TNUMFLT;
-        state->registry.rdx.value.n = 0;
-
-        for (ull i = 0; i < 64; i++) {
-            state->registry.args[i].tt = SAKURA_TNUMFLT;
-            state->registry.args[i].value.n = 0;
-        }
+        state->registry.rax = sakuraY_makeTNumber(0);
+        state->registry.rbx = sakuraY_makeTNumber(0);
+        state->registry.rcx = sakuraY_makeTNumber(0);
+        state->registry.rdx = sakuraY_makeTNumber(0);
 
-        state->internalOffset = 0;
+        for (ull i = 0; i < 64; i++)
+            state->registry.args[i] = sakuraY_makeTNumber(0);
     }
 
     return state;
@@ -61,25 +49,33 @@ SakuraState *sakura_createState(void) {
 void sakura_destroyState(SakuraState *state) {
     if (state != NULL) {
         sakuraX_destroyTVMap(&state->globals);
-        for (ull i = 0; i < state->pool.size; i++) {
-            if (state->pool.constants[i].tt == SAKURA_TSTR)
-                s_str_free(&state->pool.constants[i].value.s);
-        }
-        free(state->pool.constants);
-        state->pool.constants = NULL;
-        state->pool.size = 0;
+        sakuraX_freeNodeArena(&state->nodeArena);
+        for (ull i = 0; i < state->chunkCount; i++)
+            sakuraX_freeAssembly(state->chunks[i]);
+        free(state->chunks);
         free(state->callStack);
         state->callStack = NULL;
         state->callStackSize = 0;
         state->callStackIndex = 0;
-        for (ull i = 0; i < state->localsSize; i++)
-            s_str_free(&state->locals[i]);
-        free(state->locals);
-        state->locals = NULL;
+        free(state->locals.symbols);
+        free(state->locals.index);
         free(state);
     }
 }
 
+void sakura_keepChunk(SakuraState *S, struct SakuraAssembly *assembly) {
+    if (S->chunkCount == S->chunkCapacity) {
+        S->chunkCapacity = S->chunkCapacity == 0 ? 4 : S->chunkCapacity * 2;
+        S->chunks = (struct SakuraAssembly **)realloc(S->chunks, S->chunkCapacity * sizeof(struct SakuraAssembly *));
+        if (S->chunks == NULL) {
+            printf("Error: failed to allocate memory for chunks\n");
+            exit(1);
+        }
+    }
+
+    S->chunks[S->chunkCount++] = assembly;
+}
+
 void sakuraDEBUG_dumpStack(SakuraState *S) {
     if (S->stackIndex == 0) {
         printf("[Stack Dump]: No stack values to dump\n");
@@ -89,13 +85,15 @@ void sakuraDEBUG_dumpStack(SakuraState *S) {
     printf("[Stack Dump]: dump (%p-%d):\n", S, S->stackIndex);
     for (int i = 0; i < S->stackIndex; i++) {
         printf("  [%d] ", i);
-        if (S->stack[i].tt == SAKURA_TNUMFLT) {
-            printf("%f\n", S->stack[i].value.n);
-        } else if (S->stack[i].tt == SAKURA_TSTR) {
-            printf("%.*s\n", S->stack[i].value.s.len, S->stack[i].value.s.str);
-        } else if (S->stack[i].tt == SAKURA_TCFUNC) {
-            printf("[CFunc %p]\n", S->stack[i].value.cfn);
-        } else if (S->stack[i].tt == SAKURA_TFUNC) {
+        if (TV_TYPE(S->stack[i]) == SAKURA_TNUMFLT) {
+            printf("%f\n", TV_NUM(S->stack[i]));
+        } else if (TV_TYPE(S->stack[i]) == SAKURA_TNUMINT) {
+            printf("%lld\n", TV_INT(S->stack[i]));
+        } else if (TV_TYPE(S->stack[i]) == SAKURA_TSTR) {
+            printf("%.*s\n", TV_STR(S->stack[i])->len, TV_STR(S->stack[i])->str);
+        } else if (TV_TYPE(S->stack[i]) == SAKURA_TCFUNC) {
+            printf("[CFunc %p]\n", (void *)(uintptr_t)TV_CFN(S->stack[i]));
+        } else if (TV_TYPE(S->stack[i]) == SAKURA_TFUNC) {
             printf("[SakuraFunc '<NIL>']\n");
         } else {
             printf("[Unknown]\n");
@@ -106,9 +104,10 @@ void sakuraDEBUG_dumpStack(SakuraState *S) {
 }
 
 void sakuraDEBUG_dumpTokens(struct TokenStack *tokens) {
+    // only the lookahead the parser hasn't read yet is still around
     printf("[Token Dump]: dump:\n");
-    for (ull i = 0; i < tokens->size; i++) {
-        struct Token *token = tokens->tokens[i];
+    for (ull i = 0; i < tokens->count; i++) {
+        struct Token *token = &tokens->ring[(tokens->head + i) & (SAKURA_TOKEN_LOOKAHEAD - 1)];
         printf("    [%d]:\t'%.*s'\n", token->type, (int)token->length, token->start);
     }
     printf("[Token Dump]: end dump\n");
@@ -136,129 +135,188 @@ void sakuraX_initializeTVMap(struct TVMap *map, ull initCapacity) {
     map->size = 0;
     map->capacity = initCapacity;
 
-    for (ull i = 0; i < initCapacity; i++) {
-        map->pairs[i].init = 0;
-        map->pairs[i].key.str = NULL;
-        map->pairs[i].key.len = 0;
-    }
+    map->index = NULL;
+    map->indexCapacity = 0;
+    sakuraX_resizeTVMap(map, initCapacity * 2);
 }
 
 void sakuraX_resizeTVMap(struct TVMap *map, ull newCapacity) {
-    struct TVMapPair *oldPairs = map->pairs;
-    ull oldCapacity = map->capacity;
+    ull mask;
+
+    // only the index is rebuilt, slots keep their numbers
+    free(map->index);
+    map->index = (int *)malloc(newCapacity * sizeof(int));
+    map->indexCapacity = newCapacity;
+    mask = newCapacity - 1;
+
+    for (ull i = 0; i < newCapacity; i++)
+        map->index[i] = -1;
+
+    for (ull slot = 0; slot < map->size; slot++) {
+        ull idx = map->pairs[slot].hash & mask;
+        while (map->index[idx] != -1)
+            idx = (idx + 1) & mask;
+        map->index[idx] = (int)slot;
+    }
+}
 
-    map->pairs = (struct TVMapPair *)malloc(newCapacity * sizeof(struct TVMapPair));
-    map->size = 0;
-    map->capacity = newCapacity;
+int sakuraX_TVMapSlot(struct TVMap *map, const struct s_str *key) {
+    int slot = sakuraX_TVMapGetIndex(map, key);
+    ull idx, mask;
 
-    for (ull i = 0; i < newCapacity; i++) {
-        map->pairs[i].init = 0;
-        map->pairs[i].key.str = NULL;
-        map->pairs[i].key.len = 0;
-    }
+    if (slot != -1)
+        return slot;
 
-    for (ull i = 0; i < oldCapacity; i++) {
-        if (oldPairs[i].init == 1) {
-            sakuraX_TVMapInsert(map, &oldPairs[i].key, oldPairs[i].value);
-            s_str_free(&oldPairs[i].key); // Free the old key (assuming ownership transfer)
-        }
+    // keep the index at most half full
+    if ((map->size + 1) * 2 > map->indexCapacity)
+        sakuraX_resizeTVMap(map, map->indexCapacity * 2);
+
+    if (map->size >= map->capacity) {
+        map->capacity *= 2;
+        map->pairs = (struct TVMapPair *)realloc(map->pairs, map->capacity * sizeof(struct TVMapPair));
     }
 
-    free(oldPairs);
-}
+    slot = (int)map->size++;
+    map->pairs[slot].key = s_str_copy(key);
+    map->pairs[slot].value = sakuraY_makeTNil();
+    map->pairs[slot].hash = sakuraX_hashForTVMap(key->str, key->len);
 
-void sakuraX_TVMapInsert(struct TVMap *map, const struct s_str *key, TValue value) {
-    ull idx;
+    mask = map->indexCapacity - 1;
+    idx = map->pairs[slot].hash & mask;
+    while (map->index[idx] != -1)
+        idx = (idx + 1) & mask;
+    map->index[idx] = slot;
 
-    if ((double)map->size / map->capacity >= 0.5) {
-        sakuraX_resizeTVMap(map, map->capacity * 2);
-    }
+    return slot;
+}
 
-    idx = sakuraX_hashForTVMap(key->str, key->len, map->capacity);
-    map->pairs[idx].key = s_str_copy(key);
-    map->pairs[idx].value = value;
-    map->pairs[idx].init = 1;
-    map->size++;
+int sakuraX_TVMapInsert(struct TVMap *map, const struct s_str *key, TValue value) {
+    int slot = sakuraX_TVMapSlot(map, key);
+    map->pairs[slot].value = value;
+    return slot;
 }
 
 int sakuraX_TVMapGetIndex(struct TVMap *map, const struct s_str *key) {
-    ull idx = sakuraX_hashForTVMap(key->str, key->len, map->capacity);
-    return map->pairs[idx].init == 1 ? (int)idx : -1;
+    uint32_t hash = sakuraX_hashForTVMap(key->str, key->len);
+    ull mask = map->indexCapacity - 1, idx = hash & mask;
+
+    while (map->index[idx] != -1) {
+        struct TVMapPair *pair = &map->pairs[map->index[idx]];
+        if (pair->hash == hash && pair->key.len == key->len && memcmp(pair->key.str, key->str, key->len) == 0)
+            return map->index[idx];
+
+        idx = (idx + 1) & mask;
+    }
+
+    return -1;
 }
 
 TValue *sakuraX_TVMapGet(struct TVMap *map, const struct s_str *key) {
-    ull idx = sakuraX_hashForTVMap(key->str, key->len, map->capacity);
-    return map->pairs[idx].init == 1 ? &map->pairs[idx].value : NULL;
+    int slot = sakuraX_TVMapGetIndex(map, key);
+    return slot != -1 ? &map->pairs[slot].value : NULL;
 }
 
 TValue *sakuraX_TVMapGet_c(struct TVMap *map, const char *key) {
-    ull idx = sakuraX_hashForTVMap(key, strlen(key), map->capacity);
-    return map->pairs[idx].init == 1 ? &map->pairs[idx].value : NULL;
+    struct s_str name;
+    name.str = (char *)key;
+    name.len = strlen(key);
+    return sakuraX_TVMapGet(map, &name);
 }
 
 void sakuraX_destroyTVMap(struct TVMap *map) {
-    for (ull i = 0; i < map->capacity; i++) {
-        if (map->pairs[i].init == 0)
-            continue;
+    for (ull i = 0; i < map->size; i++) {
         s_str_free(&map->pairs[i].key);
-        if (map->pairs[i].value.tt == SAKURA_TSTR) {
-            s_str_free(&map->pairs[i].value.value.s);
+        if (TV_TYPE(map->pairs[i].value) == SAKURA_TSTR) {
+            free(TV_STR(map->pairs[i].value));
         }
     }
     free(map->pairs);
+    free(map->index);
     map->pairs = NULL;
+    map->index = NULL;
     map->size = 0;
     map->capacity = 0;
+    map->indexCapacity = 0;
 }
 
 void sakuraY_attemptFreeTValue(TValue *val) {
-    if (val->tt == SAKURA_TFUNC) {
-        sakuraX_freeAssembly(val->value.assembly);
+    if (TV_TYPE(*val) == SAKURA_TFUNC) {
+        sakuraX_freeAssembly(TV_FUNC(*val));
     }
 }
 
+struct SakuraString *sakuraY_newString(const char *str, int len) {
+    struct SakuraString *string = (struct SakuraString *)malloc(sizeof(struct SakuraString) + len);
+    if (string == NULL) {
+        printf("Error: failed to allocate memory for string\n");
+        exit(1);
+    }
+
+    string->len = len;
+    memcpy(string->str, str, len);
+    return string;
+}
+
+struct s_str sakuraY_viewString(const struct SakuraString *string) {
+    struct s_str view;
+    view.str = (char *)string->str;
+    view.len = string->len;
+    return view;
+}
+
 TValue sakuraY_makeTNumber(double value) {
     TValue val;
+#ifdef SAKURA_NAN_BOXING
+    // every NaN is stored as the same positive quiet NaN so it can't look like a boxed value
+    if (isnan(value))
+        val.bits = SAKURA_NANBOX_CANON;
+    else
+        val.n = value;
+#else
     val.tt = SAKURA_TNUMFLT;
     val.value.n = value;
+#endif
+    return val;
+}
+
+TValue sakuraY_makeTInteger(long long value) {
+    TValue val;
+    TV_SETINT(val, value);
     return val;
 }
 
-TValue sakuraY_makeTString(struct s_str *value) {
+TValue sakuraY_makeTString(const struct s_str *value) {
     TValue val;
-    val.tt = SAKURA_TSTR;
-    val.value.s = s_str_copy(value);
+    TV_MAKE(val, SAKURA_TSTR, s, sakuraY_newString(value->str, value->len));
     return val;
 }
 
 TValue sakuraY_makeTCFunc(int (*fnPtr)(SakuraState *)) {
     TValue val;
-    val.tt = SAKURA_TCFUNC;
-    val.value.cfn = fnPtr;
+    TV_MAKE(val, SAKURA_TCFUNC, cfn, fnPtr);
     return val;
 }
 
 TValue sakuraY_makeTFunc(struct SakuraAssembly *assembly) {
     TValue val;
-    val.tt = SAKURA_TFUNC;
-    val.value.assembly = assembly;
+    TV_MAKE(val, SAKURA_TFUNC, assembly, assembly);
     return val;
 }
 
-TValue sakuraY_makeTTable(void) {
+TValue sakuraY_makeTNil(void) {
     TValue val;
-    val.tt = SAKURA_TTABLE;
-    val.value.table = sakuraX_initializeTTable();
+    TV_MAKE(val, SAKURA_TNIL, nil, 0);
+    return val;
+}
+
+TValue sakuraY_makeTTable(ull arraySize) {
+    TValue val;
+    TV_MAKE(val, SAKURA_TTABLE, table, sakuraX_initializeTTable(arraySize));
     return val;
 }
 
 void sakura_setGlobal(SakuraState *S, const struct s_str *name) {
-    TValue *val = sakuraX_TVMapGet(&S->globals, name);
-    if (val == NULL) {
-        sakuraX_TVMapInsert(&S->globals, name, sakuraY_pop(S));
-    } else {
-        *val = sakuraY_pop(S);
-    }
+    sakuraX_TVMapInsert(&S->globals, name, sakuraY_pop(S));
 }
 
 void sakuraY_push(SakuraState *S, TValue val) {
@@ -310,113 +368,261 @@ int sakura_peek(SakuraState *S) {
         exit(1);
     }
 
-    return (int)(S->stack[S->stackIndex - 1].value.n);
+    return (int)TV_TOFLT(S->stack[S->stackIndex - 1]);
 }
 
-int sakura_isNumber(SakuraState *S) { return sakuraY_peek(S)->tt == SAKURA_TNUMFLT; }
-int sakura_isString(SakuraState *S) { return sakuraY_peek(S)->tt == SAKURA_TSTR; }
+int sakura_isNumber(SakuraState *S) { return TV_ISNUMBER(*sakuraY_peek(S)); }
+int sakura_isInteger(SakuraState *S) { return TV_ISINT(*sakuraY_peek(S)); }
+int sakura_isString(SakuraState *S) { return TV_TYPE(*sakuraY_peek(S)) == SAKURA_TSTR; }
 
+// either subtype is accepted, integers are converted
 double sakura_popNumber(SakuraState *S) {
     TValue val = sakuraY_pop(S);
-    if (val.tt != SAKURA_TNUMFLT) {
-        printf("Error: expected number, got %d\n", val.tt);
+    if (!TV_ISNUMBER(val)) {
+        printf("Error: expected number, got %d\n", TV_TYPE(val));
         exit(1);
     }
-    return val.value.n;
+    return TV_TOFLT(val);
+}
+
+// floats are accepted when they have an exact integer value
+long long sakura_popInteger(SakuraState *S) {
+    TValue val = sakuraY_pop(S);
+    long long i;
+
+    if (TV_ISINT(val))
+        return TV_INT(val);
+
+    if (TV_TYPE(val) != SAKURA_TNUMFLT || !sakuraX_floatToInteger(TV_NUM(val), &i)) {
+        printf("Error: expected integer, got %d\n", TV_TYPE(val));
+        exit(1);
+    }
+    return i;
 }
 
 struct s_str sakura_popString(SakuraState *S) {
     TValue val = sakuraY_pop(S);
-    if (val.tt != SAKURA_TSTR) {
-        printf("Error: expected string, got %d\n", val.tt);
+    if (TV_TYPE(val) != SAKURA_TSTR) {
+        printf("Error: expected string, got %d\n", TV_TYPE(val));
         exit(1);
     }
-    return val.value.s;
+    return sakuraY_viewString(TV_STR(val));
 }
 
-void sakuraY_storeLocal(SakuraState *S, const struct s_str *name, int idx) {
-    if (idx >= (int)S->localsSize) {
-        S->locals = (struct s_str *)realloc(S->locals, (idx + 1) * sizeof(struct s_str));
+ull sakuraY_findLocalSlot(struct SakuraSymbolTable *table, const struct s_str *name, uint32_t hash) {
+    ull mask = table->indexCapacity - 1, slot = hash & mask;
+
+    for (; table->index[slot] != 0; slot = (slot + 1) & mask) {
+        struct SakuraSymbol *symbol = &table->symbols[table->index[slot] - 1];
+        if (symbol->hash == hash && symbol->name.len == name->len &&
+            memcmp(symbol->name.str, name->str, name->len) == 0)
+            return slot;
+    }
 
-        for (int i = (int)S->localsSize; i < idx + 1; i++) {
-            S->locals[i].str = NULL;
-            S->locals[i].len = 0;
+    return slot;
+}
+
+void sakuraY_storeLocal(SakuraState *S, const struct s_str *name, int idx) {
+    struct SakuraSymbolTable *table = &S->locals;
+    uint32_t hash = (uint32_t)sakuraX_hashBytes(name->str, name->len, 0);
+    ull slot;
+
+    // rebuilding in declaration order keeps the newest symbol last in its probe run, which sakuraY_closeScope needs
+    if ((table->size + 1) * 2 > table->indexCapacity) {
+        ull mask;
+
+        free(table->index);
+        table->indexCapacity = table->indexCapacity ? table->indexCapacity * 2 : 16;
+        table->index = (uint32_t *)calloc(table->indexCapacity, sizeof(uint32_t));
+        mask = table->indexCapacity - 1;
+
+        for (ull i = 0; i < table->size; i++) {
+            slot = table->symbols[i].hash & mask;
+            while (table->index[slot] != 0)
+                slot = (slot + 1) & mask;
+            table->index[slot] = (uint32_t)(i + 1);
         }
+    }
+
+    slot = sakuraY_findLocalSlot(table, name, hash);
+    if (table->index[slot] != 0) {
+        table->symbols[table->index[slot] - 1].reg = idx;
+        return;
+    }
 
-        S->localsSize = idx + 1;
+    if (table->size >= table->capacity) {
+        table->capacity = table->capacity ? table->capacity * 2 : 16;
+        table->symbols = (struct SakuraSymbol *)realloc(table->symbols, table->capacity * sizeof(struct SakuraSymbol));
     }
 
-    S->locals[idx] = s_str_copy(name);
+    table->symbols[table->size].name = *name;
+    table->symbols[table->size].hash = hash;
+    table->symbols[table->size].reg = idx;
+    table->index[slot] = (uint32_t)++table->size;
+}
+
+int sakuraY_findLocal(SakuraState *S, const struct s_str *name) {
+    struct SakuraSymbolTable *table = &S->locals;
+    ull slot;
+
+    if (table->size == 0)
+        return -1;
+
+    slot = sakuraY_findLocalSlot(table, name, (uint32_t)sakuraX_hashBytes(name->str, name->len, 0));
+    return table->index[slot] != 0 ? table->symbols[table->index[slot] - 1].reg : -1;
+}
+
+ull sakuraY_openScope(SakuraState *S) { return S->locals.size; }
+
+void sakuraY_closeScope(SakuraState *S, ull scope) {
+    struct SakuraSymbolTable *table = &S->locals;
+    ull mask = table->indexCapacity - 1;
+
+    // nothing was declared after the symbols being dropped, so their slots can simply be emptied
+    while (table->size > scope) {
+        ull slot = table->symbols[table->size - 1].hash & mask;
+
+        while (table->index[slot] != table->size)
+            slot = (slot + 1) & mask;
+        table->index[slot] = 0;
+        table->size--;
+    }
+}
+
+void sakuraY_enterLocals(SakuraState *S, struct SakuraSymbolTable *saved) {
+    *saved = S->locals;
+
+    S->locals.symbols = NULL;
+    S->locals.size = 0;
+    S->locals.capacity = 0;
+    S->locals.index = NULL;
+    S->locals.indexCapacity = 0;
+}
+
+void sakuraY_leaveLocals(SakuraState *S, struct SakuraSymbolTable *saved) {
+    free(S->locals.symbols);
+    free(S->locals.index);
+
+    S->locals = *saved;
 }
 
 void copyTValue(TValue *dest, TValue *src) {
-    dest->tt = src->tt;
-    if (src->tt == SAKURA_TNUMFLT) {
-        dest->value.n = src->value.n;
-    } else if (src->tt == SAKURA_TSTR) {
-        dest->value.s = s_str_copy(&src->value.s);
+    if (TV_TYPE(*src) == SAKURA_TSTR) {
+        struct s_str view = sakuraY_viewString(TV_STR(*src));
+        *dest = sakuraY_makeTString(&view);
     } else {
         // Handle other types as needed
-        dest->value = src->value;
+        *dest = *src;
+    }
+}
+
+// 64-bit finalizer from murmur3, spreads every input bit over the whole result
+uint64_t sakuraX_mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// seeded FNV-1a over the bytes, finished with the mixer so short keys still differ in the low bits
+uint64_t sakuraX_hashBytes(const char *bytes, ull len, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (ull i = 0; i < len; i++) {
+        h ^= (unsigned char)bytes[i];
+        h *= 0x100000001b3ULL;
     }
+    return sakuraX_mixHash(h ^ len);
+}
+
+int sakuraX_floatToInteger(double n, long long *i) {
+    // the range check comes first, converting a float outside of it is undefined
+    if (!(n >= -9223372036854775808.0 && n < 9223372036854775808.0) || n != (double)(long long)n)
+        return 0;
+
+    *i = (long long)n;
+    return 1;
 }
 
-void sakuraY_mergePools(SakuraState *S, SakuraConstantPool *pool) {
-    S->pool.capacity += pool->capacity;
-    S->pool.constants = (TValue *)realloc(S->pool.constants, S->pool.capacity * sizeof(TValue));
-    for (ull i = 0; i < pool->size; i++)
-        copyTValue(&S->pool.constants[S->pool.size + i], &pool->constants[i]);
-    S->pool.size += pool->size;
+// modulo floors like lua's, the result takes the sign of the divisor. y can't be 0, -1 is special cased since
+// LLONG_MIN % -1 overflows
+long long sakuraX_modInteger(long long x, long long y) {
+    long long m;
+
+    if (y == -1)
+        return 0;
+
+    m = x % y;
+    if (m != 0 && (m ^ y) < 0)
+        m += y;
+    return m;
 }
 
-void sakuraY_mergePoolsA(SakuraConstantPool *into, SakuraConstantPool *from) {
-    into->capacity += from->capacity;
-    into->constants = (TValue *)realloc(into->constants, into->capacity * sizeof(TValue));
-    for (ull i = 0; i < from->size; i++)
-        copyTValue(&into->constants[into->size + i], &from->constants[i]);
-    into->size += from->size;
+double sakuraX_modFloat(double x, double y) {
+    double m = fmod(x, y);
+
+    if (m != 0 && (m < 0) != (y < 0))
+        m += y;
+    return m;
 }
 
-unsigned int sakuraX_hashTValue(const TValue *key, ull capacity) {
-    unsigned int hashValue = 0;
-    hashValue ^= key->tt;
+uint32_t sakuraX_hashTValue(const TValue *key, uint64_t seed) {
+    uint64_t bits;
+    long long i;
+    double n;
 
-    switch (key->tt) {
+    switch (TV_TYPE(*key)) {
+    case SAKURA_TNUMINT:
+        return (uint32_t)sakuraX_mixHash((uint64_t)TV_INT(*key) ^ seed);
     case SAKURA_TNUMFLT:
-        hashValue ^= (unsigned int)key->value.n;
-        break;
+        // a float with an integer value is the same key as that integer, 0 and -0 both end up as integer 0
+        if (sakuraX_floatToInteger(TV_NUM(*key), &i))
+            return (uint32_t)sakuraX_mixHash((uint64_t)i ^ seed);
+
+        n = TV_NUM(*key);
+        memcpy(&bits, &n, sizeof(bits));
+        return (uint32_t)sakuraX_mixHash(bits ^ seed);
     case SAKURA_TSTR:
-        for (int i = 0; i < key->value.s.len; i++)
-            hashValue ^= key->value.s.str[i];
-        break;
+        return (uint32_t)sakuraX_hashBytes(TV_STR(*key)->str, TV_STR(*key)->len, seed);
     case SAKURA_TCFUNC:
-        hashValue ^= (unsigned int)(intptr_t)key->value.cfn;
-        break;
+        return (uint32_t)sakuraX_mixHash((uint64_t)(uintptr_t)TV_CFN(*key) ^ seed);
     case SAKURA_TFUNC:
-        hashValue ^= (unsigned int)(intptr_t)key->value.assembly;
-        break;
+        return (uint32_t)sakuraX_mixHash((uint64_t)(uintptr_t)TV_FUNC(*key) ^ seed);
+    case SAKURA_TTABLE:
+        return (uint32_t)sakuraX_mixHash((uint64_t)(uintptr_t)TV_TABLE(*key) ^ seed);
     }
 
-    return hashValue % capacity;
+    return (uint32_t)sakuraX_mixHash(seed ^ (uint64_t)TV_TYPE(*key));
 }
 
 int sakuraX_compareTValues(const TValue *a, const TValue *b) {
-    if (a->tt != b->tt)
+    long long i;
+
+    if (TV_TYPE(*a) != TV_TYPE(*b)) {
+        // an integer equals a float with exactly its value
+        if (TV_ISINT(*a) && TV_TYPE(*b) == SAKURA_TNUMFLT)
+            return sakuraX_floatToInteger(TV_NUM(*b), &i) && i == TV_INT(*a);
+        if (TV_ISINT(*b) && TV_TYPE(*a) == SAKURA_TNUMFLT)
+            return sakuraX_floatToInteger(TV_NUM(*a), &i) && i == TV_INT(*b);
         return 0;
+    }
 
-    switch (a->tt) {
+    switch (TV_TYPE(*a)) {
+    case SAKURA_TNUMINT:
+        return TV_INT(*a) == TV_INT(*b);
     case SAKURA_TNUMFLT:
-        return a->value.n == b->value.n;
+        return TV_NUM(*a) == TV_NUM(*b);
     case SAKURA_TSTR:
-        return a->value.s.len == b->value.s.len && memcmp(a->value.s.str, b->value.s.str, a->value.s.len) == 0;
+        return TV_STR(*a)->len == TV_STR(*b)->len && memcmp(TV_STR(*a)->str, TV_STR(*b)->str, TV_STR(*a)->len) == 0;
     case SAKURA_TCFUNC:
-        return a->value.cfn == b->value.cfn;
+        return TV_CFN(*a) == TV_CFN(*b);
     case SAKURA_TFUNC:
-        return a->value.assembly == b->value.assembly;
+        return TV_FUNC(*a) == TV_FUNC(*b);
     case SAKURA_TNIL:
         return 1;
     case SAKURA_TTABLE:
-        return a->value.table == b->value.table;
+        return TV_TABLE(*a) == TV_TABLE(*b);
     }
 
     return 0;
@@ -432,15 +638,18 @@ char *sakuraX_readTVal(TValue *val) {
         return allocVal;
     }
 
-    switch (val->tt) {
+    switch (TV_TYPE(*val)) {
     case SAKURA_TNUMFLT:
-        sprintf(allocVal, "%f", val->value.n);
+        sprintf(allocVal, "%f", TV_NUM(*val));
+        break;
+    case SAKURA_TNUMINT:
+        sprintf(allocVal, "%lld", TV_INT(*val));
         break;
     case SAKURA_TSTR:
-        sprintf(allocVal, "'%.*s'", val->value.s.len, val->value.s.str);
+        sprintf(allocVal, "'%.*s'", TV_STR(*val)->len, TV_STR(*val)->str);
         break;
     default:
-        sprintf(allocVal, "[Unknown T%d D%f @ %p (%p)]", val->tt, val->value.n, val, &val->tt);
+        sprintf(allocVal, "[Unknown T%d D%f @ %p]", TV_TYPE(*val), TV_NUM(*val), (void *)val);
         break;
     }
 
@@ -458,16 +667,19 @@ char *sakuraX_readTValC(TValue *val) {
         return allocVal;
     }
 
-    switch (val->tt) {
+    switch (TV_TYPE(*val)) {
     case SAKURA_TNUMFLT:
-        sprintf(allocVal, "\x1b[33m%f\x1b[0m", val->value.n);
+        sprintf(allocVal, "\x1b[33m%f\x1b[0m", TV_NUM(*val));
+        break;
+    case SAKURA_TNUMINT:
+        sprintf(allocVal, "\x1b[33m%lld\x1b[0m", TV_INT(*val));
         break;
     case SAKURA_TSTR:
-        sprintf(allocVal, "\x1b[32m'%.*s'\x1b[0m", val->value.s.len, val->value.s.str);
+        sprintf(allocVal, "\x1b[32m'%.*s'\x1b[0m", TV_STR(*val)->len, TV_STR(*val)->str);
         break;
     default:
-        sprintf(allocVal, "\x1b[31m[Unknown \x1b[33mT%d D%f\x1b[31m @ \x1b[33m%p (%p)\x1b[31m]\x1b[0m", val->tt,
-                val->value.n, val, &val->tt);
+        sprintf(allocVal, "\x1b[31m[Unknown \x1b[33mT%d D%f\x1b[31m @ \x1b[33m%p\x1b[31m]\x1b[0m", TV_TYPE(*val),
+                TV_NUM(*val), (void *)val);
         break;
     }
 
@@ -12,15 +12,17 @@ typedef long long unsigned int ull;
 
 SakuraState *sakura_createState(void);
 void sakura_destroyState(SakuraState *state);
+void sakura_keepChunk(SakuraState *S, struct SakuraAssembly *assembly);
 
 void sakuraDEBUG_dumpStack(SakuraState *S);
 void sakuraDEBUG_dumpTokens(struct TokenStack *tokens);
 void sakuraDEBUG_dumpConstantPool(SakuraConstantPool *pool);
 
-unsigned int sakuraX_hashForTVMap(const char *key, ull len, ull capacity);
+uint32_t sakuraX_hashForTVMap(const char *key, ull len);
 void sakuraX_initializeTVMap(struct TVMap *map, ull initCapacity);
 void sakuraX_resizeTVMap(struct TVMap *map, ull newCapacity);
-void sakuraX_TVMapInsert(struct TVMap *map, const struct s_str *key, TValue value);
+int sakuraX_TVMapSlot(struct TVMap *map, const struct s_str *key);
+int sakuraX_TVMapInsert(struct TVMap *map, const struct s_str *key, TValue value);
 int sakuraX_TVMapGetIndex(struct TVMap *map, const struct s_str *key);
 TValue *sakuraX_TVMapGet(struct TVMap *map, const struct s_str *key);
 TValue *sakuraX_TVMapGet_c(struct TVMap *map, const char *key);
@@ -32,16 +34,18 @@ void copyTValue(TValue *dest, TValue *src);
 #define GET_TAG(value) ((value) >> 29)
 #define REMOVE_TAG(value) ((ull)((value) & 0x1FFFFFFF))
 
-void sakuraY_mergePools(SakuraState *S, SakuraConstantPool *pool);
-void sakuraY_mergePoolsA(SakuraConstantPool *into, SakuraConstantPool *from);
-
 void sakuraY_attemptFreeTValue(TValue *val);
 
+struct SakuraString *sakuraY_newString(const char *str, int len);
+struct s_str sakuraY_viewString(const struct SakuraString *string);
+
 TValue sakuraY_makeTNumber(double value);
-TValue sakuraY_makeTString(struct s_str *value);
+TValue sakuraY_makeTInteger(long long value);
+TValue sakuraY_makeTString(const struct s_str *value);
 TValue sakuraY_makeTCFunc(int (*fnPtr)(SakuraState *));
 TValue sakuraY_makeTFunc(struct SakuraAssembly *assembly);
-TValue sakuraY_makeTTable(void);
+TValue sakuraY_makeTNil(void);
+TValue sakuraY_makeTTable(ull arraySize);
 
 void sakura_setGlobal(SakuraState *S, const struct s_str *name);
 
@@ -51,15 +55,29 @@ TValue sakuraY_popN(SakuraState *S, int n);
 TValue *sakuraY_peek(SakuraState *S);
 int sakura_peek(SakuraState *S);
 
+// locals are resolved through a hashed symbol table, each function gets its own and blocks scope theirs
+ull sakuraY_findLocalSlot(struct SakuraSymbolTable *table, const struct s_str *name, uint32_t hash);
 void sakuraY_storeLocal(SakuraState *S, const struct s_str *name, int idx);
+int sakuraY_findLocal(SakuraState *S, const struct s_str *name);
+ull sakuraY_openScope(SakuraState *S);
+void sakuraY_closeScope(SakuraState *S, ull scope);
+void sakuraY_enterLocals(SakuraState *S, struct SakuraSymbolTable *saved);
+void sakuraY_leaveLocals(SakuraState *S, struct SakuraSymbolTable *saved);
 
 int sakura_isNumber(SakuraState *S);
+int sakura_isInteger(SakuraState *S);
 int sakura_isString(SakuraState *S);
 
 double sakura_popNumber(SakuraState *S);
+long long sakura_popInteger(SakuraState *S);
 struct s_str sakura_popString(SakuraState *S);
 
-unsigned int sakuraX_hashTValue(const TValue *key, ull capacity);
+uint64_t sakuraX_mixHash(uint64_t h);
+uint64_t sakuraX_hashBytes(const char *bytes, ull len, uint64_t seed);
+int sakuraX_floatToInteger(double n, long long *i);
+long long sakuraX_modInteger(long long x, long long y);
+double sakuraX_modFloat(double x, double y);
+uint32_t sakuraX_hashTValue(const TValue *key, uint64_t seed);
 int sakuraX_compareTValues(const TValue *a, const TValue *b);
 
 char *sakuraX_readTVal(TValue *val);
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "assembler.h"
+#include "compiler.h"
 #include "disasm.h"
 #include "filesystem.h"
 #include "parser.h"
@@ -11,49 +12,46 @@
 
 void sakuraL_loadStdlib(SakuraState *S) {
     sakura_register(S, "print", sakuraS_print);
+    sakura_register(S, "clock", sakuraS_clock);
     sakura_register(S, "loadstring", sakuraS_loadstring);
     sakura_register(S, "loadfile", sakuraS_loadfile);
     sakura_register(S, "dofile", sakuraS_dofile);
 }
 
 void sakuraL_loadfile(SakuraState *S, const char *file, int showDisasm) {
-    struct s_str source = readfile(file);
+    struct s_file source = mapfile(file);
 
     LOG_CALL();
 
-    if (source.str == NULL) {
+    if (source.content.str == NULL) {
         printf("Error: could not read file %s\n", file);
         LOG_POP();
         return;
     }
 
-    sakuraL_loadstring(S, &source, showDisasm);
+    // the lexer reads straight out of the mapping
+    sakuraL_loadstring(S, &source.content, showDisasm);
 
-    s_str_free(&source);
+    unmapfile(&source);
 
     LOG_POP();
 }
 
 void sakuraL_loadstring(SakuraState *S, struct s_str *source, int showDisasm) {
-    struct TokenStack *tokens;
-    struct NodeStack *nodes;
     struct SakuraAssembly *assembly;
 
     LOG_CALL();
 
     sakuraL_loadStdlib(S);
 
-    tokens = sakuraY_analyze(S, source);
-    nodes = sakuraY_parse(S, tokens);
-    sakuraX_freeTokStack(tokens); // may need to move this to after assembly
-    assembly = sakuraY_assemble(S, nodes);
-    sakuraX_freeNodeStack(nodes);
+    assembly = sakuraY_compileSource(S, source);
 
     if (showDisasm >= 1)
         sakuraX_writeDisasm(S, assembly, "test.sa", showDisasm);
     sakuraX_interpret(S, assembly);
 
-    sakuraX_freeAssembly(assembly);
+    // a later chunk on the same state can still call the functions this one declared
+    sakura_keepChunk(S, assembly);
 
     LOG_POP();
 }
@@ -0,0 +1,225 @@
+#pragma once
+
+// threaded dispatch table for sakuraX_interpretA, included inside the interpreter function since labels are local
+// to it. entries are indexed by opcode, so this has to be kept in the same order as the defines in assembler.h.
+// opcodes without a handler jump to the unknown instruction error, the table covers every value of the 8 bit opcode
+// field so a corrupt instruction lands there too instead of reading past the end.
+
+static const void *const dispatchTable[256] = {
+    &&L_SAKURA_MOVE,       // 0
+    &&L_SAKURA_LOADK,      // 1
+    &&L_SAKURA_LOADNIL,    // 2
+    &&L_SAKURA_GETGLOBAL,  // 3
+    &&L_SAKURA_SETGLOBAL,  // 4
+    &&L_SAKURA_GETTABLE,   // 5
+    &&L_SAKURA_SETTABLE,   // 6
+    &&L_SAKURA_CLOSURE,    // 7
+    &&L_SAKURA_CALL,       // 8
+    &&L_SAKURA_RETURN,     // 9
+    &&L_SAKURA_ADD,        // 10
+    &&L_SAKURA_SUB,        // 11
+    &&L_SAKURA_MUL,        // 12
+    &&L_SAKURA_DIV,        // 13
+    &&L_SAKURA_MOD,        // 14
+    &&L_SAKURA_POW,        // 15
+    &&L_SAKURA_UNM,        // 16
+    &&L_DEFAULT,           // 17 pop
+    &&L_SAKURA_EQ,         // 18
+    &&L_SAKURA_LT,         // 19
+    &&L_SAKURA_LE,         // 20
+    &&L_SAKURA_NOT,        // 21
+    &&L_SAKURA_JMP,        // 22
+    &&L_SAKURA_JMPIF,      // 23
+    &&L_DEFAULT,           // 24 concat
+    &&L_DEFAULT,           // 25 lenstr
+    &&L_SAKURA_LENTBL,     // 26
+    &&L_DEFAULT,           // 27 band
+    &&L_DEFAULT,           // 28 bor
+    &&L_DEFAULT,           // 29 bxor
+    &&L_DEFAULT,           // 30 bnot
+    &&L_DEFAULT,           // 31 shl
+    &&L_DEFAULT,           // 32 shr
+    &&L_SAKURA_NEWTABLE,   // 33
+    &&L_SAKURA_TAILCALL,   // 34
+    &&L_SAKURA_WIDE,       // 35
+    &&L_SAKURA_NE,         // 36
+    &&L_SAKURA_ADDK,       // 37
+    &&L_SAKURA_SUBK,       // 38
+    &&L_SAKURA_MULK,       // 39
+    &&L_SAKURA_LTJMP,      // 40
+    &&L_SAKURA_LEJMP,      // 41
+    &&L_SAKURA_EQJMP,      // 42
+    &&L_SAKURA_NEJMP,      // 43
+    &&L_SAKURA_CALLGLOBAL, // 44
+    &&L_SAKURA_ADDN,       // 45
+    &&L_SAKURA_SUBN,       // 46
+    &&L_SAKURA_MULN,       // 47
+    &&L_SAKURA_DIVN,       // 48
+    &&L_SAKURA_ADDKN,      // 49
+    &&L_SAKURA_SUBKN,      // 50
+    &&L_SAKURA_MULKN,      // 51
+    &&L_SAKURA_ADDI,       // 52
+    &&L_SAKURA_SUBI,       // 53
+    &&L_SAKURA_MULI,       // 54
+    &&L_SAKURA_ADDKI,      // 55
+    &&L_SAKURA_SUBKI,      // 56
+    &&L_SAKURA_MULKI,      // 57
+    &&L_SAKURA_TADDI,      // 58
+    &&L_SAKURA_TSUBI,      // 59
+    &&L_SAKURA_TMULI,      // 60
+    &&L_SAKURA_TADDKI,     // 61
+    &&L_SAKURA_TSUBKI,     // 62
+    &&L_SAKURA_TMULKI,     // 63
+    &&L_SAKURA_TADDF,      // 64
+    &&L_SAKURA_TSUBF,      // 65
+    &&L_SAKURA_TMULF,      // 66
+    &&L_SAKURA_TDIVF,      // 67
+    &&L_SAKURA_TADDKF,     // 68
+    &&L_SAKURA_TSUBKF,     // 69
+    &&L_SAKURA_TMULKF,     // 70
+    &&L_SAKURA_TLTJMPI,    // 71
+    &&L_SAKURA_TLEJMPI,    // 72
+    &&L_SAKURA_TLTJMPF,    // 73
+    &&L_SAKURA_TLEJMPF,    // 74
+    [SAKURA_OPCODE_COUNT ... 255] = &&L_DEFAULT,
+};
+
+// wide instructions enter their handler past the operand unpacking. these are plain gotos rather than a second label
+// table, an address taken label is a target of every threaded jump and would keep all the operands alive across them
+#define VM_WIDE(op)                                                                                                    \
+    switch (op) {                                                                                                      \
+    case SAKURA_MOVE:                                                                                                  \
+        goto W_SAKURA_MOVE;                                                                                            \
+    case SAKURA_LOADK:                                                                                                 \
+        goto W_SAKURA_LOADK;                                                                                           \
+    case SAKURA_LOADNIL:                                                                                               \
+        goto W_SAKURA_LOADNIL;                                                                                         \
+    case SAKURA_GETGLOBAL:                                                                                             \
+        goto W_SAKURA_GETGLOBAL;                                                                                       \
+    case SAKURA_SETGLOBAL:                                                                                             \
+        goto W_SAKURA_SETGLOBAL;                                                                                       \
+    case SAKURA_GETTABLE:                                                                                              \
+        goto W_SAKURA_GETTABLE;                                                                                        \
+    case SAKURA_SETTABLE:                                                                                              \
+        goto W_SAKURA_SETTABLE;                                                                                        \
+    case SAKURA_CLOSURE:                                                                                               \
+        goto W_SAKURA_CLOSURE;                                                                                         \
+    case SAKURA_CALL:                                                                                                  \
+        goto W_SAKURA_CALL;                                                                                            \
+    case SAKURA_RETURN:                                                                                                \
+        goto W_SAKURA_RETURN;                                                                                          \
+    case SAKURA_ADD:                                                                                                   \
+        goto W_SAKURA_ADD;                                                                                             \
+    case SAKURA_SUB:                                                                                                   \
+        goto W_SAKURA_SUB;                                                                                             \
+    case SAKURA_MUL:                                                                                                   \
+        goto W_SAKURA_MUL;                                                                                             \
+    case SAKURA_DIV:                                                                                                   \
+        goto W_SAKURA_DIV;                                                                                             \
+    case SAKURA_MOD:                                                                                                   \
+        goto W_SAKURA_MOD;                                                                                             \
+    case SAKURA_POW:                                                                                                   \
+        goto W_SAKURA_POW;                                                                                             \
+    case SAKURA_UNM:                                                                                                   \
+        goto W_SAKURA_UNM;                                                                                             \
+    case SAKURA_EQ:                                                                                                    \
+        goto W_SAKURA_EQ;                                                                                              \
+    case SAKURA_LT:                                                                                                    \
+        goto W_SAKURA_LT;                                                                                              \
+    case SAKURA_LE:                                                                                                    \
+        goto W_SAKURA_LE;                                                                                              \
+    case SAKURA_NOT:                                                                                                   \
+        goto W_SAKURA_NOT;                                                                                             \
+    case SAKURA_NE:                                                                                                    \
+        goto W_SAKURA_NE;                                                                                              \
+    case SAKURA_JMP:                                                                                                   \
+        goto W_SAKURA_JMP;                                                                                             \
+    case SAKURA_JMPIF:                                                                                                 \
+        goto W_SAKURA_JMPIF;                                                                                           \
+    case SAKURA_LENTBL:                                                                                                \
+        goto W_SAKURA_LENTBL;                                                                                          \
+    case SAKURA_NEWTABLE:                                                                                              \
+        goto W_SAKURA_NEWTABLE;                                                                                        \
+    case SAKURA_TAILCALL:                                                                                              \
+        goto W_SAKURA_TAILCALL;                                                                                        \
+    case SAKURA_ADDK:                                                                                                  \
+        goto W_SAKURA_ADDK;                                                                                            \
+    case SAKURA_SUBK:                                                                                                  \
+        goto W_SAKURA_SUBK;                                                                                            \
+    case SAKURA_MULK:                                                                                                  \
+        goto W_SAKURA_MULK;                                                                                            \
+    case SAKURA_LTJMP:                                                                                                 \
+        goto W_SAKURA_LTJMP;                                                                                           \
+    case SAKURA_LEJMP:                                                                                                 \
+        goto W_SAKURA_LEJMP;                                                                                           \
+    case SAKURA_EQJMP:                                                                                                 \
+        goto W_SAKURA_EQJMP;                                                                                           \
+    case SAKURA_NEJMP:                                                                                                 \
+        goto W_SAKURA_NEJMP;                                                                                           \
+    case SAKURA_CALLGLOBAL:                                                                                            \
+        goto W_SAKURA_CALLGLOBAL;                                                                                      \
+    case SAKURA_ADDN:                                                                                                  \
+        goto W_SAKURA_ADDN;                                                                                            \
+    case SAKURA_SUBN:                                                                                                  \
+        goto W_SAKURA_SUBN;                                                                                            \
+    case SAKURA_MULN:                                                                                                  \
+        goto W_SAKURA_MULN;                                                                                            \
+    case SAKURA_DIVN:                                                                                                  \
+        goto W_SAKURA_DIVN;                                                                                            \
+    case SAKURA_ADDKN:                                                                                                 \
+        goto W_SAKURA_ADDKN;                                                                                           \
+    case SAKURA_SUBKN:                                                                                                 \
+        goto W_SAKURA_SUBKN;                                                                                           \
+    case SAKURA_MULKN:                                                                                                 \
+        goto W_SAKURA_MULKN;                                                                                           \
+    case SAKURA_ADDI:                                                                                                  \
+        goto W_SAKURA_ADDI;                                                                                            \
+    case SAKURA_SUBI:                                                                                                  \
+        goto W_SAKURA_SUBI;                                                                                            \
+    case SAKURA_MULI:                                                                                                  \
+        goto W_SAKURA_MULI;                                                                                            \
+    case SAKURA_ADDKI:                                                                                                 \
+        goto W_SAKURA_ADDKI;                                                                                           \
+    case SAKURA_SUBKI:                                                                                                 \
+        goto W_SAKURA_SUBKI;                                                                                           \
+    case SAKURA_MULKI:                                                                                                 \
+        goto W_SAKURA_MULKI;                                                                                           \
+    case SAKURA_TADDI:                                                                                                 \
+        goto W_SAKURA_TADDI;                                                                                           \
+    case SAKURA_TSUBI:                                                                                                 \
+        goto W_SAKURA_TSUBI;                                                                                           \
+    case SAKURA_TMULI:                                                                                                 \
+        goto W_SAKURA_TMULI;                                                                                           \
+    case SAKURA_TADDKI:                                                                                                \
+        goto W_SAKURA_TADDKI;                                                                                          \
+    case SAKURA_TSUBKI:                                                                                                \
+        goto W_SAKURA_TSUBKI;                                                                                          \
+    case SAKURA_TMULKI:                                                                                                \
+        goto W_SAKURA_TMULKI;                                                                                          \
+    case SAKURA_TADDF:                                                                                                 \
+        goto W_SAKURA_TADDF;                                                                                           \
+    case SAKURA_TSUBF:                                                                                                 \
+        goto W_SAKURA_TSUBF;                                                                                           \
+    case SAKURA_TMULF:                                                                                                 \
+        goto W_SAKURA_TMULF;                                                                                           \
+    case SAKURA_TDIVF:                                                                                                 \
+        goto W_SAKURA_TDIVF;                                                                                           \
+    case SAKURA_TADDKF:                                                                                                \
+        goto W_SAKURA_TADDKF;                                                                                          \
+    case SAKURA_TSUBKF:                                                                                                \
+        goto W_SAKURA_TSUBKF;                                                                                          \
+    case SAKURA_TMULKF:                                                                                                \
+        goto W_SAKURA_TMULKF;                                                                                          \
+    case SAKURA_TLTJMPI:                                                                                               \
+        goto W_SAKURA_TLTJMPI;                                                                                         \
+    case SAKURA_TLEJMPI:                                                                                               \
+        goto W_SAKURA_TLEJMPI;                                                                                         \
+    case SAKURA_TLTJMPF:                                                                                               \
+        goto W_SAKURA_TLTJMPF;                                                                                         \
+    case SAKURA_TLEJMPF:                                                                                               \
+        goto W_SAKURA_TLEJMPF;                                                                                         \
+    case SAKURA_WIDE:                                                                                                  \
+        goto W_SAKURA_WIDE;                                                                                            \
+    default:                                                                                                           \
+        goto L_DEFAULT;                                                                                                \
+    }
@@ -0,0 +1,179 @@
+#include "slexer.h"
+
+#include <stddef.h>
+
+#ifdef SAKURA_LEXER_SIMD
+#include <immintrin.h>
+#endif
+
+unsigned char sakuraX_charClass[256];
+enum SakuraLexerMode sakuraX_lexerMode = SAKURA_LEXER_SCALAR;
+
+int (*sakuraX_scanClass)(const char *str, int i, int len, unsigned char cls) = NULL;
+int (*sakuraX_scanQuote)(const char *str, int i, int len, char quoteChar) = NULL;
+
+void sakuraX_initLexer(void) {
+    // the table replaces the libc ctype calls, so the lexer doesn't depend on the locale
+    for (int c = 0; c < 256; c++) {
+        unsigned char cls = 0;
+
+        if (c == ' ' || (c >= '\t' && c <= '\r'))
+            cls |= SAKURA_CHAR_SPACE;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+            cls |= SAKURA_CHAR_ALPHA;
+        if (c >= '0' && c <= '9')
+            cls |= SAKURA_CHAR_DIGIT;
+        if (c == '.')
+            cls |= SAKURA_CHAR_DOT;
+
+        sakuraX_charClass[c] = cls;
+    }
+
+    sakuraX_lexerMode = SAKURA_LEXER_SCALAR;
+    sakuraX_scanClass = sakuraX_scanClassScalar;
+    sakuraX_scanQuote = sakuraX_scanQuoteScalar;
+
+#ifdef SAKURA_LEXER_SIMD
+    // sse2 is part of the x86-64 baseline, avx2 has to be checked on the cpu we're running on
+    sakuraX_lexerMode = SAKURA_LEXER_SSE2;
+    sakuraX_scanClass = sakuraX_scanClassSSE2;
+    sakuraX_scanQuote = sakuraX_scanQuoteSSE2;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        sakuraX_lexerMode = SAKURA_LEXER_AVX2;
+        sakuraX_scanClass = sakuraX_scanClassAVX2;
+        sakuraX_scanQuote = sakuraX_scanQuoteAVX2;
+    }
+#endif
+}
+
+int sakuraX_scanRun(const char *str, int i, int len, unsigned char cls) {
+    int end = i + SAKURA_SHORT_RUN < len ? i + SAKURA_SHORT_RUN : len;
+
+    // most identifiers and numbers are short, the vector scanners only pay off once a run gets long
+    while (i < end && (sakuraX_charClass[(unsigned char)str[i]] & cls))
+        i++;
+
+    return i < end || i == len ? i : sakuraX_scanClass(str, i, len, cls);
+}
+
+int sakuraX_scanClassScalar(const char *str, int i, int len, unsigned char cls) {
+    while (i < len && (sakuraX_charClass[(unsigned char)str[i]] & cls))
+        i++;
+
+    return i;
+}
+
+int sakuraX_scanQuoteScalar(const char *str, int i, int len, char quoteChar) {
+    while (i < len && str[i] != quoteChar && str[i] != '\\')
+        i++;
+
+    return i;
+}
+
+#ifdef SAKURA_LEXER_SIMD
+
+// lo <= v <= hi for unsigned bytes, sse2 only has signed compares so this goes through min/max
+#define SSE2_IN_RANGE(v, lo, hi)                                                                                       \
+    _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(lo)), v),                                               \
+                  _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(hi)), v))
+#define AVX2_IN_RANGE(v, lo, hi)                                                                                       \
+    _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(lo)), v),                                   \
+                     _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(hi)), v))
+
+int sakuraX_scanClassSSE2(const char *str, int i, int len, unsigned char cls) {
+    // the vector loop only runs on full 16 byte blocks, the tail goes through the table
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+        __m128i match = _mm_setzero_si128();
+        unsigned int mask;
+
+        if (cls & SAKURA_CHAR_SPACE)
+            match = _mm_or_si128(match, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                     SSE2_IN_RANGE(v, '\t', '\r')));
+        if (cls & SAKURA_CHAR_ALPHA) {
+            __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+            match = _mm_or_si128(match, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+                                                     SSE2_IN_RANGE(lower, 'a', 'z')));
+        }
+        if (cls & SAKURA_CHAR_DIGIT)
+            match = _mm_or_si128(match, SSE2_IN_RANGE(v, '0', '9'));
+        if (cls & SAKURA_CHAR_DOT)
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+
+        mask = (unsigned int)_mm_movemask_epi8(match);
+        if (mask != 0xFFFF)
+            return i + __builtin_ctz(~mask);
+
+        i += 16;
+    }
+
+    return sakuraX_scanClassScalar(str, i, len, cls);
+}
+
+int sakuraX_scanQuoteSSE2(const char *str, int i, int len, char quoteChar) {
+    __m128i quote = _mm_set1_epi8(quoteChar), escape = _mm_set1_epi8('\\');
+
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+        unsigned int mask =
+            (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, escape)));
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+
+        i += 16;
+    }
+
+    return sakuraX_scanQuoteScalar(str, i, len, quoteChar);
+}
+
+__attribute__((target("avx2"))) int sakuraX_scanClassAVX2(const char *str, int i, int len, unsigned char cls) {
+    while (i + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+        __m256i match = _mm256_setzero_si256();
+        unsigned int mask;
+
+        if (cls & SAKURA_CHAR_SPACE)
+            match = _mm256_or_si256(match, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                           AVX2_IN_RANGE(v, '\t', '\r')));
+        if (cls & SAKURA_CHAR_ALPHA) {
+            __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+            match = _mm256_or_si256(match, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')),
+                                                           AVX2_IN_RANGE(lower, 'a', 'z')));
+        }
+        if (cls & SAKURA_CHAR_DIGIT)
+            match = _mm256_or_si256(match, AVX2_IN_RANGE(v, '0', '9'));
+        if (cls & SAKURA_CHAR_DOT)
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')));
+
+        mask = (unsigned int)_mm256_movemask_epi8(match);
+        if (mask != 0xFFFFFFFF)
+            return i + __builtin_ctz(~mask);
+
+        i += 32;
+    }
+
+    // runs of at least 16 bytes are still worth one sse2 step before the table
+    return sakuraX_scanClassSSE2(str, i, len, cls);
+}
+
+__attribute__((target("avx2"))) int sakuraX_scanQuoteAVX2(const char *str, int i, int len, char quoteChar) {
+    __m256i quote = _mm256_set1_epi8(quoteChar), escape = _mm256_set1_epi8('\\');
+
+    while (i + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, escape)));
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+
+        i += 32;
+    }
+
+    return sakuraX_scanQuoteSSE2(str, i, len, quoteChar);
+}
+
+#endif
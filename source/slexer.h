@@ -0,0 +1,40 @@
+#pragma once
+
+// character classes used by the lexer, a byte can be in more than one
+#define SAKURA_CHAR_SPACE 0x01 // ' ', \t, \n, \v, \f, \r
+#define SAKURA_CHAR_ALPHA 0x02 // letters and '_', the start of an identifier
+#define SAKURA_CHAR_DIGIT 0x04
+#define SAKURA_CHAR_DOT 0x08
+
+#define SAKURA_CHAR_IDENT (SAKURA_CHAR_ALPHA | SAKURA_CHAR_DIGIT)
+#define SAKURA_CHAR_NUMBER (SAKURA_CHAR_DIGIT | SAKURA_CHAR_DOT)
+
+// runs up to this long are scanned a byte at a time before handing off to the vector scanners
+#define SAKURA_SHORT_RUN 8
+
+// use -DSAKURA_NO_SIMD to build the lexer with the scalar scanners only
+#if !defined(SAKURA_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SAKURA_LEXER_SIMD
+#endif
+
+enum SakuraLexerMode { SAKURA_LEXER_SCALAR, SAKURA_LEXER_SSE2, SAKURA_LEXER_AVX2 };
+
+extern unsigned char sakuraX_charClass[256];
+extern enum SakuraLexerMode sakuraX_lexerMode;
+
+// both return the index of the first byte at or after i that stops the scan, or len
+extern int (*sakuraX_scanClass)(const char *str, int i, int len, unsigned char cls);
+extern int (*sakuraX_scanQuote)(const char *str, int i, int len, char quoteChar);
+
+void sakuraX_initLexer(void);
+int sakuraX_scanRun(const char *str, int i, int len, unsigned char cls);
+
+int sakuraX_scanClassScalar(const char *str, int i, int len, unsigned char cls);
+int sakuraX_scanQuoteScalar(const char *str, int i, int len, char quoteChar);
+
+#ifdef SAKURA_LEXER_SIMD
+int sakuraX_scanClassSSE2(const char *str, int i, int len, unsigned char cls);
+int sakuraX_scanQuoteSSE2(const char *str, int i, int len, char quoteChar);
+int sakuraX_scanClassAVX2(const char *str, int i, int len, unsigned char cls);
+int sakuraX_scanQuoteAVX2(const char *str, int i, int len, char quoteChar);
+#endif
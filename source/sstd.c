@@ -2,8 +2,10 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "assembler.h"
+#include "compiler.h"
 #include "disasm.h"
 #include "filesystem.h"
 #include "parser.h"
@@ -14,7 +16,9 @@ int sakuraS_print(SakuraState *S) {
     sakuraY_pop(S);
 
     for (int i = 0; i < args; i++) {
-        if (sakura_isNumber(S)) {
+        if (sakura_isInteger(S)) {
+            printf("%lld    ", sakura_popInteger(S));
+        } else if (sakura_isNumber(S)) {
             char output[50];
             ull len;
 
@@ -36,8 +40,12 @@ int sakuraS_print(SakuraState *S) {
         } else if (sakura_isString(S)) {
             struct s_str val = sakura_popString(S);
             printf("%.*s    ", val.len, val.str);
+        } else if (TV_TYPE(*sakuraY_peek(S)) == SAKURA_TNIL) {
+            sakuraY_pop(S);
+            printf("nil    ");
         } else {
             printf("[%p]    ", sakuraY_peek(S));
+            sakuraY_pop(S);
         }
     }
 
@@ -45,12 +53,24 @@ int sakuraS_print(SakuraState *S) {
     return 0;
 }
 
+int sakuraS_clock(SakuraState *S) {
+    int args = (int)sakura_popNumber(S);
+
+    if (args != 0) {
+        printf("Error: expected 0 arguments, got %d\n", args);
+        exit(1);
+    }
+
+    // processor time in seconds, for timing scripts
+    sakuraY_push(S, sakuraY_makeTNumber((double)clock() / CLOCKS_PER_SEC));
+
+    return 1;
+}
+
 int sakuraS_loadstring(SakuraState *S) {
     int args = (int)sakura_popNumber(S);
     struct s_str source;
 
-    struct TokenStack *tokens;
-    struct NodeStack *nodes;
     struct SakuraAssembly *assembly;
 
     if (args != 1) {
@@ -60,12 +80,8 @@ int sakuraS_loadstring(SakuraState *S) {
 
     source = sakura_popString(S);
 
-    // parse the source
-    tokens = sakuraY_analyze(S, &source);
-    nodes = sakuraY_parse(S, tokens);
-    sakuraX_freeTokStack(tokens);
-    assembly = sakuraY_assemble(S, nodes);
-    sakuraX_freeNodeStack(nodes);
+    // compile the source
+    assembly = sakuraY_compileSource(S, &source);
 
     // push return value
     sakuraY_push(S, sakuraY_makeTFunc(assembly));
@@ -75,10 +91,9 @@ int sakuraS_loadstring(SakuraState *S) {
 
 int sakuraS_loadfile(SakuraState *S) {
     int args = sakura_popNumber(S);
-    struct s_str file, source;
+    struct s_str file;
+    struct s_file source;
 
-    struct TokenStack *tokens;
-    struct NodeStack *nodes;
     struct SakuraAssembly *assembly;
 
     if (args != 1) {
@@ -87,37 +102,31 @@ int sakuraS_loadfile(SakuraState *S) {
     }
 
     file = sakura_popString(S);
-    source = readfile_s(&file);
-    if (source.str == NULL) {
+    source = mapfile_s(&file);
+    if (source.content.str == NULL) {
         printf("Error: could not read file '%.*s'\n", file.len, file.str);
         exit(1);
     }
 
-    // parse the source
-    tokens = sakuraY_analyze(S, &source);
-    nodes = sakuraY_parse(S, tokens);
-    sakuraX_freeTokStack(tokens);
-    assembly = sakuraY_assemble(S, nodes);
-    sakuraX_freeNodeStack(nodes);
+    // compile the source
+    assembly = sakuraY_compileSource(S, &source.content);
 
     // push return value
     sakuraY_push(S, sakuraY_makeTFunc(assembly));
 
     // cleanup
-    s_str_free(&source);
+    unmapfile(&source);
 
     return 1;
 }
 
 int sakuraS_dofile(SakuraState *S) {
     int args = sakura_popNumber(S);
-    struct s_str file, source;
+    struct s_str file;
+    struct s_file source;
 
-    struct TokenStack *tokens;
-    struct NodeStack *nodes;
     struct SakuraAssembly *assembly;
 
-    ull originalOffset;
     int retVals;
 
     if (args != 1) {
@@ -126,27 +135,21 @@ int sakuraS_dofile(SakuraState *S) {
     }
 
     file = sakura_popString(S);
-    source = readfile_s(&file);
-    if (source.str == NULL) {
+    source = mapfile_s(&file);
+    if (source.content.str == NULL) {
         printf("Error: could not read file '%.*s'\n", file.len, file.str);
         exit(1);
     }
 
-    // parse the source
-    tokens = sakuraY_analyze(S, &source);
-    nodes = sakuraY_parse(S, tokens);
-    sakuraX_freeTokStack(tokens);
-    assembly = sakuraY_assemble(S, nodes);
-    sakuraX_freeNodeStack(nodes);
+    // compile the source
+    assembly = sakuraY_compileSource(S, &source.content);
 
-    originalOffset = S->internalOffset;
-    S->internalOffset = S->stackIndex;
+    // the chunk runs above the current stack top and leaves its results there
     retVals = sakuraX_interpret(S, assembly);
-    S->internalOffset = originalOffset;
 
-    // cleanup
-    s_str_free(&source);
-    sakuraX_freeAssembly(assembly);
+    // cleanup, the functions the chunk declared stay reachable through its globals
+    unmapfile(&source);
+    sakura_keepChunk(S, assembly);
 
     return retVals;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "sakura.h"
 
 int sakuraS_print(SakuraState *S);
+int sakuraS_clock(SakuraState *S);
 int sakuraS_loadstring(SakuraState *S);
 int sakuraS_loadfile(SakuraState *S);
 int sakuraS_dofile(SakuraState *S);
\ No newline at end of file
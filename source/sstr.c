@@ -45,6 +45,20 @@ struct s_str s_str_concat(const struct s_str *s1, const struct s_str *s2) {
     return s;
 }
 
+struct s_str s_str_concat_i(const struct s_str *sstr1, long long value) {
+    char output[24];
+
+    sprintf(output, "%lld", value);
+    return s_str_concat_c(sstr1, output);
+}
+
+struct s_str s_str_concat_ii(long long value, const struct s_str *sstr1) {
+    char output[24];
+
+    sprintf(output, "%lld", value);
+    return s_str_concat_s(output, sstr1);
+}
+
 struct s_str s_str_concat_c(const struct s_str *s1, const char *s2) {
     struct s_str s;
     s.len = s1->len + strlen(s2);
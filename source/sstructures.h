@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #define SAKURA_STACK_SIZE 8000
 
 #define SAKURA_FLAG_LEXER 0
@@ -14,7 +16,7 @@
 #define SAKURA_EFLAG_RUNTIME 2
 #define SAKURA_EFLAG_FATAL 3
 
-// #define SAKURA_TNUMINT 1 // integer tag
+#define SAKURA_TNUMINT 1 // integer tag
 #define SAKURA_TNUMFLT 0 // float tag
 #define SAKURA_TSTR 2    // string tag
 #define SAKURA_TCFUNC 3  // C function tag
@@ -28,6 +30,7 @@ typedef unsigned short SakuraFlag;
 
 struct SakuraState;
 struct SakuraTTable;
+struct SakuraAssembly;
 
 enum TokenType {
     // Single Character Tokens (fsize_ty implemented)
@@ -85,9 +88,10 @@ enum TokenType {
     SAKURA_NODE_VAR,
     SAKURA_NODE_TABLE,
     SAKURA_NODE_INDEX,
+    SAKURA_NODE_RETURN,
 
     // Misc
-    SAKURA_TOKEN_SENTINEL // for telling the binary operation parser to stop
+    SAKURA_TOKEN_SENTINEL // one past the last type, also marks a node without a token
 };
 
 struct Token {
@@ -96,40 +100,129 @@ struct Token {
     size_t length;
 };
 
+// a number literal as the parser and compiler carry it, integers keep their exact value instead of going through a
+// double
+struct SakuraNumber {
+    int isInteger; // i holds the value, n otherwise
+    long long i;
+    double n;
+};
+
+#define SAKURA_NUMBER_FLOAT(x) ((x).isInteger ? (double)(x).i : (x).n)
+
 struct Node {
     enum TokenType type;
     struct Node *left;
     struct Node *right;
-    struct Token *token;
+    struct Token token; // copied out of the lexer, which only keeps its lookahead around
 
     struct Node **keys;
 
     struct Node **args;
     size_t argCount;
+    size_t argCapacity; // keys, when present, has the same capacity as args
 
     struct Node *elseBlock;
 
-    double storageValue;
+    struct SakuraNumber storageValue; // value of a number literal
 
     int leftLocation;
     int rightLocation;
 };
 
+// how many tokens the lexer can buffer ahead of the parser, must be a power of two
+#define SAKURA_TOKEN_LOOKAHEAD 8
+
+// the lexer runs on demand as the parser peeks and pops, tokens go through a small ring instead of an array
+// holding the whole source, so a popped token is only valid until the next pop
 struct TokenStack {
-    struct Token **tokens;
-    size_t size;
+    const char *source;
+    int length;
+    int position; // next byte to lex
+
+    struct Token ring[SAKURA_TOKEN_LOOKAHEAD];
+    size_t head;  // ring index of the next token to read
+    size_t count; // tokens lexed but not read yet
+    size_t lexed; // tokens produced so far
+
+    int quiet;   // skip the messages for bad characters, the single-pass compiler retries through the parser instead
+    int invalid; // bad characters skipped so far
+};
+
+// bump allocated storage for one compilation's nodes and child arrays, released all at once by a reset
+struct NodeArenaBlock {
+    struct NodeArenaBlock *next;
+    size_t used;
     size_t capacity;
+    unsigned char data[];
 };
 
+struct NodeArena {
+    struct NodeArenaBlock *blocks; // newest block first
+};
+
+#define SAKURA_NODE_ARENA_BLOCK 16384    // size of the first block
+#define SAKURA_NODE_ARENA_KEEP (1 << 20) // a reset frees the blocks instead of keeping them past this size
+
 struct NodeStack {
     struct Node **nodes;
     size_t size;
     size_t capacity;
+    size_t cursor; // next node to read
+    struct NodeArena *arena;
+};
+
+// heap allocated string object, the characters follow the header in the same allocation and are not nul terminated
+struct SakuraString {
+    int len;
+    char str[];
 };
 
+#ifdef SAKURA_NAN_BOXING
+// values are packed into 8 bytes. numbers are stored as plain doubles (with NaNs canonicalized to a positive quiet
+// NaN), every other type sets the sign and quiet NaN bits, keeps its tag in bits 48-50 and a pointer in the low 48
+// bits. a negative quiet NaN is never produced by sakuraY_makeTNumber, so the two can't be confused.
+// integers are boxed the same way with a 48 bit two's complement payload, one that doesn't fit is stored as a float
+#define SAKURA_NANBOX_MASK 0xFFF8000000000000ULL
+#define SAKURA_NANBOX_CANON 0x7FF8000000000000ULL
+#define SAKURA_NANBOX_PTR 0x0000FFFFFFFFFFFFULL
+#define SAKURA_NANBOX_INT (SAKURA_NANBOX_MASK | (uint64_t)SAKURA_TNUMINT << 48)
+
+typedef union {
+    double n;
+    uint64_t bits;
+} TValue;
+
+#define TV_ISBOXED(v) (((v).bits & SAKURA_NANBOX_MASK) == SAKURA_NANBOX_MASK)
+#define TV_TYPE(v) (TV_ISBOXED(v) ? (int)(((v).bits >> 48) & 7) : SAKURA_TNUMFLT)
+#define TV_BOX(tag, ptr) (SAKURA_NANBOX_MASK | ((uint64_t)(tag) << 48) | ((uint64_t)(uintptr_t)(ptr) & SAKURA_NANBOX_PTR))
+#define TV_PTR(v) ((uintptr_t)((v).bits & SAKURA_NANBOX_PTR))
+#define TV_MAKE(v, tag, field, ptr) ((v).bits = TV_BOX(tag, ptr))
+
+#define TV_NUM(v) ((v).n)
+#define TV_INT(v) ((long long)((int64_t)((v).bits << 16) >> 16))
+#define TV_ISINT(v) (((v).bits & 0xFFFF000000000000ULL) == SAKURA_NANBOX_INT)
+#define TV_ISNUMBER(v) (!TV_ISBOXED(v) | TV_ISINT(v))
+// both values are floats, both integers or both numbers of either subtype, each tested with a single branch
+#define TV_BOTHFLT(v, w) (!TV_ISBOXED(v) & !TV_ISBOXED(w))
+#define TV_BOTHINT(v, w) (TV_ISINT(v) & TV_ISINT(w))
+#define TV_BOTHNUMBER(v, w) (TV_ISNUMBER(v) & TV_ISNUMBER(w))
+// store the number d in v without a call to sakuraY_makeTNumber, d is evaluated more than once
+#define TV_SETNUM(v, d) ((d) != (d) ? (void)((v).bits = SAKURA_NANBOX_CANON) : (void)((v).n = (d)))
+// store the integer x in v without a call to sakuraY_makeTInteger, x is evaluated more than once
+#define TV_SETINT(v, x)                                                                                                \
+    ((long long)((int64_t)((uint64_t)(x) << 16) >> 16) == (x)                                                          \
+         ? (void)((v).bits = SAKURA_NANBOX_INT | ((uint64_t)(x) & SAKURA_NANBOX_PTR))                                  \
+         : (void)((v).n = (double)(x)))
+#define TV_STR(v) ((struct SakuraString *)TV_PTR(v))
+#define TV_CFN(v) ((int (*)(struct SakuraState *))TV_PTR(v))
+#define TV_FUNC(v) ((struct SakuraAssembly *)TV_PTR(v))
+#define TV_TABLE(v) ((struct SakuraTTable *)TV_PTR(v))
+#else
 union SakuraValue {
     double n;                         // TNUMFLT
-    struct s_str s;                   // TSTR
+    long long i;                      // TNUMINT
+    struct SakuraString *s;           // TSTR
     int (*cfn)(struct SakuraState *); // TCFUNC
     struct SakuraAssembly *assembly;  // TFUNC
     int nil;                          // TNIL
@@ -142,10 +235,42 @@ typedef struct {
     union SakuraValue value;
 } TValue;
 
+#define TV_TYPE(v) ((v).tt)
+#define TV_MAKE(v, tag, field, ptr) ((v).tt = (tag), (v).value.field = (ptr))
+
+#define TV_NUM(v) ((v).value.n)
+#define TV_INT(v) ((v).value.i)
+#define TV_ISINT(v) (TV_TYPE(v) == SAKURA_TNUMINT)
+#define TV_ISNUMBER(v) (TV_TYPE(v) <= SAKURA_TNUMINT)
+// both values are floats, both integers or both numbers of either subtype, each tested with a single branch since the
+// number tags are 0 and 1
+#define TV_BOTHFLT(v, w) ((TV_TYPE(v) | TV_TYPE(w)) == SAKURA_TNUMFLT)
+#define TV_BOTHINT(v, w) ((TV_TYPE(v) << 3 | TV_TYPE(w)) == (SAKURA_TNUMINT << 3 | SAKURA_TNUMINT))
+#define TV_BOTHNUMBER(v, w) ((TV_TYPE(v) | TV_TYPE(w)) <= SAKURA_TNUMINT)
+// store the number d in v without a call to sakuraY_makeTNumber
+#define TV_SETNUM(v, d) ((v).tt = SAKURA_TNUMFLT, (v).value.n = (d))
+// store the integer x in v without a call to sakuraY_makeTInteger
+#define TV_SETINT(v, x) ((v).tt = SAKURA_TNUMINT, (v).value.i = (x))
+#define TV_STR(v) ((v).value.s)
+#define TV_CFN(v) ((v).value.cfn)
+#define TV_FUNC(v) ((v).value.assembly)
+#define TV_TABLE(v) ((v).value.table)
+#endif // SAKURA_NAN_BOXING
+
+// value of a number of either subtype as a float
+#define TV_TOFLT(v) (TV_ISINT(v) ? (double)TV_INT(v) : TV_NUM(v))
+// integer arithmetic wraps around like lua's, going through unsigned keeps the overflow defined
+#define TV_INTARITH(x, operation, y) ((long long)((unsigned long long)(x)operation(unsigned long long)(y)))
+
 typedef struct {
     TValue *constants; // contents of the constant pool
     size_t size;
     size_t capacity;
+
+    uint32_t *index;      // open addressed, a slot holds the position of a constant + 1, or 0 when empty
+    size_t indexCapacity; // power of two, kept at most half full
+
+    int refs; // assemblies using the pool, the functions of a chunk share the pool of the chunk
 } SakuraConstantPool;
 
 typedef struct {
@@ -160,30 +285,60 @@ typedef struct {
 struct TVMapPair {
     struct s_str key;
     TValue value;
-    int init;
+    uint32_t hash;
 };
 
+// the pairs only ever grow, so a slot number stays valid for the life of the map and compiled code can address a
+// global by it. lookups by name go through an open addressing index over the slots.
 struct TVMap {
-    struct TVMapPair *pairs;
+    struct TVMapPair *pairs; // slots in creation order
+    size_t size;             // slots in use
+    size_t capacity;         // slots allocated
+    int *index;              // slot number of each bucket, -1 for an empty bucket
+    size_t indexCapacity;    // always a power of two
+};
+
+// a local variable known to the compiler, the name points into the source being compiled
+struct SakuraSymbol {
+    struct s_str name;
+    uint32_t hash;
+    int reg; // register holding the local
+};
+
+// locals of the function being compiled, blocks close by dropping the symbols declared since they opened
+struct SakuraSymbolTable {
+    struct SakuraSymbol *symbols;
     size_t size;
     size_t capacity;
+
+    uint32_t *index;      // open addressed, a slot holds the position of a symbol + 1, or 0 when empty
+    size_t indexCapacity; // power of two, kept at most half full
+};
+
+// saved state of a suspended caller, pushed by CALL and popped by RETURN in the interpreter loop
+struct SakuraCallFrame {
+    struct SakuraAssembly *assembly;
+    int base;  // stack index of the caller's first register
+    size_t pc; // index of the CALL instruction in the caller
 };
 
 struct SakuraState {
     TValue stack[SAKURA_STACK_SIZE];
     int stackIndex;
     SakuraRegistry registry;
-    SakuraConstantPool pool;
     struct TVMap globals;
-    struct s_str *locals;
-    size_t localsSize;
-    int *callStack;
+    struct SakuraSymbolTable locals; // compile time only
+    struct SakuraCallFrame *callStack;
     size_t callStackSize;
     size_t callStackIndex;
+    struct NodeArena nodeArena; // ast of the source being compiled
+    // chunks that already ran, globals can still point at the functions they declared so they live as long as the state
+    struct SakuraAssembly **chunks;
+    size_t chunkCount;
+    size_t chunkCapacity;
     SakuraFlag error;
     struct s_str errorMessage;
     SakuraFlag currentState;
-    size_t internalOffset;
 };
 
 typedef struct SakuraState SakuraState;
@@ -191,11 +346,18 @@ typedef struct SakuraState SakuraState;
 struct TTableHashEntry {
     TValue key;
     TValue value;
-    struct TTableHashEntry *next; // collision handling
+    uint32_t hash;  // hash of the key, kept so resizing doesn't rehash
+    uint32_t probe; // distance from the home slot plus one, 0 marks an empty slot
 };
 
+// tables keep the integer keys 0..arrayCapacity-1 in a plain array and everything else in the hash part
 struct SakuraTTable {
-    struct TTableHashEntry **hashPart;
+    TValue *arrayPart;
+    size_t arrayCapacity;
+    size_t length; // keys 0..length-1 are all set, this is what # returns
+
+    struct TTableHashEntry *hashPart; // open addressing with robin hood probing, capacity is 0 or a power of two
     size_t capacity;
     size_t size;
+    uint64_t seed;
 };
\ No newline at end of file
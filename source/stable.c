@@ -2,110 +2,335 @@
 
 #include <stdlib.h>
 
-struct SakuraTTable *sakuraX_initializeTTable(void) {
+struct SakuraTTable *sakuraX_initializeTTable(ull arraySize) {
     struct SakuraTTable *table = (struct SakuraTTable *)malloc(sizeof(struct SakuraTTable));
     if (table == NULL) {
         printf("Error: failed to allocate memory for table\n");
         exit(1);
     }
 
-    table->hashPart = (struct TTableHashEntry **)calloc(8, sizeof(struct TTableHashEntry *));
+    // the hash part is allocated on the first non-array key
+    table->hashPart = NULL;
+    table->capacity = 0;
+    table->size = 0;
+    table->seed = sakuraX_mixHash((uint64_t)(uintptr_t)table);
+
+    table->arrayPart = NULL;
+    table->arrayCapacity = 0;
+    table->length = 0;
+    if (arraySize > 0)
+        sakuraX_resizeArrayTTable(table, arraySize);
+
+    return table;
+}
+
+int sakuraX_arrayKeyTTable(const TValue *key, ull *index) {
+    double n;
+
+    // only non-negative integers can live in the array part, integer keys are checked without going through a float
+    if (TV_ISINT(*key)) {
+        if ((ull)TV_INT(*key) >= 4294967296ULL)
+            return 0;
+
+        *index = (ull)TV_INT(*key);
+        return 1;
+    }
+
+    if (TV_TYPE(*key) != SAKURA_TNUMFLT)
+        return 0;
+
+    n = TV_NUM(*key);
+    if (!(n >= 0 && n < 4294967296.0) || n != (double)(ull)n)
+        return 0;
+
+    *index = (ull)n;
+    return 1;
+}
+
+void sakuraX_insertHashTTable(struct SakuraTTable *table, const TValue *key, const TValue *value, uint32_t hash) {
+    struct TTableHashEntry entry, swap;
+    ull mask = table->capacity - 1, idx = hash & mask;
+
+    entry.key = *key;
+    entry.value = *value;
+    entry.hash = hash;
+    entry.probe = 1;
+
+    // robin hood: an entry closer to its home slot gives its place up to the one being inserted
+    while (table->hashPart[idx].probe != 0) {
+        if (table->hashPart[idx].probe < entry.probe) {
+            swap = table->hashPart[idx];
+            table->hashPart[idx] = entry;
+            entry = swap;
+        }
+
+        idx = (idx + 1) & mask;
+        entry.probe++;
+    }
+
+    table->hashPart[idx] = entry;
+    table->size++;
+}
+
+struct TTableHashEntry *sakuraX_findHashTTable(struct SakuraTTable *table, const TValue *key, uint32_t hash) {
+    ull mask = table->capacity - 1, idx = hash & mask;
+    uint32_t probe = 1;
+
+    if (table->capacity == 0)
+        return NULL;
+
+    // once the probe passes an entry closer to its home than the key would be, the key isn't in the table
+    while (table->hashPart[idx].probe >= probe) {
+        if (table->hashPart[idx].hash == hash && sakuraX_compareTValues(&table->hashPart[idx].key, key))
+            return &table->hashPart[idx];
+
+        idx = (idx + 1) & mask;
+        probe++;
+    }
+
+    return NULL;
+}
+
+void sakuraX_resizeTTable(struct SakuraTTable *table, ull newCapacity) {
+    struct TTableHashEntry *oldHashPart = table->hashPart;
+    ull oldCapacity = table->capacity;
+
+    table->hashPart = (struct TTableHashEntry *)calloc(newCapacity, sizeof(struct TTableHashEntry));
     if (table->hashPart == NULL) {
         printf("Error: failed to allocate memory for table\n");
-        free(table);
         exit(1);
     }
 
-    table->capacity = 8;
+    table->capacity = newCapacity;
     table->size = 0;
 
-    return table;
+    // entries set to nil are dropped here, this is the only place keys leave the hash part
+    for (ull i = 0; i < oldCapacity; i++) {
+        if (oldHashPart[i].probe != 0 && TV_TYPE(oldHashPart[i].value) != SAKURA_TNIL)
+            sakuraX_insertHashTTable(table, &oldHashPart[i].key, &oldHashPart[i].value, oldHashPart[i].hash);
+    }
+
+    free(oldHashPart);
 }
 
-void sakuraX_resizeTTable(struct SakuraTTable *table, ull newCapacity) {
-    struct TTableHashEntry **newHashPart =
-        (struct TTableHashEntry **)calloc(newCapacity, sizeof(struct TTableHashEntry));
-    if (newHashPart == NULL) {
+void sakuraX_resizeArrayTTable(struct SakuraTTable *table, ull newCapacity) {
+    TValue *newArrayPart;
+
+    if (newCapacity < table->arrayCapacity) {
+        sakuraX_shrinkArrayTTable(table, newCapacity);
+        return;
+    }
+
+    newArrayPart = (TValue *)realloc(table->arrayPart, newCapacity * sizeof(TValue));
+    if (newArrayPart == NULL) {
         printf("Error: failed to allocate memory for table\n");
         exit(1);
     }
 
-    for (ull i = 0; i < table->capacity; i++) {
-        struct TTableHashEntry *entry = table->hashPart[i];
-        if (entry != NULL) {
-            struct TTableHashEntry *next = entry->next;
+    for (ull i = table->arrayCapacity; i < newCapacity; i++)
+        newArrayPart[i] = sakuraY_makeTNil();
+
+    table->arrayPart = newArrayPart;
+    table->arrayCapacity = newCapacity;
+
+    // move hash entries whose keys now fall inside the array part, the emptied entries are dropped by rebuilding
+    if (table->size > 0) {
+        ull moved = 0;
 
-            unsigned int newIdx = sakuraX_hashTValue(&entry->key, newCapacity);
-            entry->next = newHashPart[newIdx];
-            newHashPart[newIdx] = entry;
+        for (ull i = 0; i < table->capacity; i++) {
+            struct TTableHashEntry *entry = &table->hashPart[i];
+            ull index;
 
-            entry = next;
+            if (entry->probe != 0 && sakuraX_arrayKeyTTable(&entry->key, &index) && index < newCapacity) {
+                table->arrayPart[index] = entry->value;
+                entry->value = sakuraY_makeTNil();
+                moved++;
+            }
         }
+
+        if (moved > 0)
+            sakuraX_resizeTTable(table, table->capacity);
     }
+}
 
-    free(table->hashPart);
-    table->hashPart = newHashPart;
-    table->capacity = newCapacity;
+// move the values at or past newCapacity into the hash part and give the rest of the array part back
+void sakuraX_shrinkArrayTTable(struct SakuraTTable *table, ull newCapacity) {
+    ull spilled = 0, newHashCapacity;
+    TValue key;
+
+    for (ull i = newCapacity; i < table->arrayCapacity; i++) {
+        if (TV_TYPE(table->arrayPart[i]) != SAKURA_TNIL)
+            spilled++;
+    }
+
+    // make room for the spilled values first, rebuilding also drops the entries set to nil
+    newHashCapacity = table->capacity < 4 ? 4 : table->capacity;
+    while ((table->size + spilled) * 4 > newHashCapacity * 3)
+        newHashCapacity *= 2;
+    if (spilled > 0 || newHashCapacity != table->capacity)
+        sakuraX_resizeTTable(table, newHashCapacity);
+
+    for (ull i = newCapacity; i < table->arrayCapacity; i++) {
+        if (TV_TYPE(table->arrayPart[i]) == SAKURA_TNIL)
+            continue;
+
+        key = sakuraY_makeTInteger((long long)i);
+        sakuraX_insertHashTTable(table, &key, &table->arrayPart[i], sakuraX_hashTValue(&key, table->seed));
+    }
+
+    if (newCapacity == 0) {
+        free(table->arrayPart);
+        table->arrayPart = NULL;
+    } else {
+        // realloc can't fail when shrinking in practice, keeping the old block is still correct if it does
+        TValue *newArrayPart = (TValue *)realloc(table->arrayPart, newCapacity * sizeof(TValue));
+        if (newArrayPart != NULL)
+            table->arrayPart = newArrayPart;
+    }
+
+    table->arrayCapacity = newCapacity;
+    if (table->length > newCapacity)
+        table->length = newCapacity;
 }
 
-void sakuraX_setTTable(struct SakuraTTable *table, const TValue *key, const TValue *value) {
-    ull hashIdx = sakuraX_hashTValue(key, table->capacity);
-    struct TTableHashEntry *entry, *newEntry;
+void sakuraX_updateLengthTTable(struct SakuraTTable *table) {
+    while (1) {
+        TValue key, value;
+
+        while (table->length < table->arrayCapacity && TV_TYPE(table->arrayPart[table->length]) != SAKURA_TNIL)
+            table->length++;
+
+        if (table->length < table->arrayCapacity || table->size == 0)
+            return;
 
-    entry = table->hashPart[hashIdx];
-    while (entry != NULL) {
-        if (sakuraX_compareTValues(&entry->key, key)) {
-            entry->value = *value;
+        // the array part is full, if the sequence continues in the hash part pull it into the array
+        key = sakuraY_makeTInteger((long long)table->arrayCapacity);
+        value = sakuraX_getTTable(table, &key);
+        if (TV_TYPE(value) == SAKURA_TNIL)
             return;
+
+        sakuraX_resizeArrayTTable(table, table->arrayCapacity < 4 ? 4 : table->arrayCapacity * 2);
+    }
+}
+
+void sakuraX_rehashTTable(struct SakuraTTable *table, const TValue *newKey) {
+    // nums[b] counts the integer keys in [2^(b-1), 2^b), nums[0] counts key 0
+    ull nums[33] = {0}, total = 0, arraySize = 0, live = 0, newCapacity, index;
+
+    for (ull i = 0; i < table->arrayCapacity; i++) {
+        if (TV_TYPE(table->arrayPart[i]) != SAKURA_TNIL) {
+            int bin = 0;
+            while (((ull)1 << bin) <= i)
+                bin++;
+            nums[bin]++;
         }
+    }
+
+    for (ull i = 0; i < table->capacity; i++) {
+        struct TTableHashEntry *entry = &table->hashPart[i];
 
-        entry = entry->next;
+        if (entry->probe != 0 && TV_TYPE(entry->value) != SAKURA_TNIL && sakuraX_arrayKeyTTable(&entry->key, &index)) {
+            int bin = 0;
+            while (((ull)1 << bin) <= index)
+                bin++;
+            nums[bin]++;
+        }
     }
 
-    newEntry = (struct TTableHashEntry *)malloc(sizeof(struct TTableHashEntry));
-    if (newEntry == NULL) {
-        printf("Error: failed to allocate memory for table\n");
-        exit(1);
+    // the key that caused the rehash counts as well
+    if (sakuraX_arrayKeyTTable(newKey, &index)) {
+        int bin = 0;
+        while (((ull)1 << bin) <= index)
+            bin++;
+        nums[bin]++;
     }
 
-    newEntry->key = *key;
-    newEntry->value = *value;
-    newEntry->next = table->hashPart[hashIdx];
-    table->hashPart[hashIdx] = newEntry;
-    table->size++;
+    // the array part is the largest power of two that would be more than half full
+    for (int bin = 0; bin < 33; bin++) {
+        total += nums[bin];
+        if (total > ((ull)1 << bin) / 2)
+            arraySize = (ull)1 << bin;
+    }
 
-    if ((double)table->size / (double)table->capacity > 0.75) {
-        ull newCapacity = table->capacity * 2;
-        sakuraX_resizeTTable(table, newCapacity);
+    // the array part follows the keys both ways, one that got sparse hands its values back to the hash part
+    if (arraySize != table->arrayCapacity) {
+        sakuraX_resizeArrayTTable(table, arraySize);
+        sakuraX_updateLengthTTable(table);
     }
+
+    // size the hash part for the live entries plus the one about to be inserted, at most 3/4 full
+    for (ull i = 0; i < table->capacity; i++) {
+        if (table->hashPart[i].probe != 0 && TV_TYPE(table->hashPart[i].value) != SAKURA_TNIL)
+            live++;
+    }
+
+    newCapacity = table->capacity < 4 ? 4 : table->capacity;
+    while ((live + 1) * 4 > newCapacity * 3)
+        newCapacity *= 2;
+
+    sakuraX_resizeTTable(table, newCapacity);
 }
 
-TValue sakuraX_getTTable(struct SakuraTTable *table, const TValue *key) {
-    TValue defaultValue = {SAKURA_TNIL, {.nil = 1}};
-    ull hashIdx = sakuraX_hashTValue(key, table->capacity);
+void sakuraX_setTTable(struct SakuraTTable *table, const TValue *key, const TValue *value) {
     struct TTableHashEntry *entry;
+    uint32_t hash;
+    ull index;
 
-    entry = table->hashPart[hashIdx];
-    while (entry != NULL) {
-        if (sakuraX_compareTValues(&entry->key, key))
-            return entry->value;
+    if (sakuraX_arrayKeyTTable(key, &index)) {
+        // appending right past a full array part grows it instead of going through the hash part
+        if (index == table->arrayCapacity && table->length == table->arrayCapacity &&
+            TV_TYPE(*value) != SAKURA_TNIL)
+            sakuraX_resizeArrayTTable(table, table->arrayCapacity < 4 ? 4 : table->arrayCapacity * 2);
 
-        entry = entry->next;
+        if (index < table->arrayCapacity) {
+            table->arrayPart[index] = *value;
+            if (TV_TYPE(*value) == SAKURA_TNIL) {
+                if (index < table->length)
+                    table->length = index;
+            } else if (index == table->length) {
+                sakuraX_updateLengthTTable(table);
+            }
+            return;
+        }
     }
 
-    return defaultValue;
-}
+    hash = sakuraX_hashTValue(key, table->seed);
+    entry = sakuraX_findHashTTable(table, key, hash);
+    if (entry != NULL) {
+        entry->value = *value;
+        return;
+    }
 
-void sakuraX_freeTTable(struct SakuraTTable *table) {
-    for (ull i = 0; i < table->capacity; ++i) {
-        struct TTableHashEntry *entry = table->hashPart[i], *next;
-        while (entry != NULL) {
-            next = entry->next;
-            free(entry);
-            entry = next;
+    // a missing key set to nil doesn't need a slot
+    if (TV_TYPE(*value) == SAKURA_TNIL)
+        return;
+
+    if ((table->size + 1) * 4 > table->capacity * 3) {
+        sakuraX_rehashTTable(table, key);
+
+        // the rehash may have grown the array part far enough to hold the key
+        if (sakuraX_arrayKeyTTable(key, &index) && index < table->arrayCapacity) {
+            sakuraX_setTTable(table, key, value);
+            return;
         }
     }
 
+    sakuraX_insertHashTTable(table, key, value, hash);
+}
+
+TValue sakuraX_getTTable(struct SakuraTTable *table, const TValue *key) {
+    struct TTableHashEntry *entry;
+    ull index;
+
+    if (sakuraX_arrayKeyTTable(key, &index) && index < table->arrayCapacity)
+        return table->arrayPart[index];
+
+    entry = sakuraX_findHashTTable(table, key, sakuraX_hashTValue(key, table->seed));
+    return entry != NULL ? entry->value : sakuraY_makeTNil();
+}
+
+void sakuraX_freeTTable(struct SakuraTTable *table) {
+    free(table->arrayPart);
     free(table->hashPart);
     free(table);
-}
\ No newline at end of file
+}
@@ -2,8 +2,15 @@
 
 #include "sakura.h"
 
-struct SakuraTTable *sakuraX_initializeTTable(void);
+struct SakuraTTable *sakuraX_initializeTTable(ull arraySize);
+int sakuraX_arrayKeyTTable(const TValue *key, ull *index);
+void sakuraX_insertHashTTable(struct SakuraTTable *table, const TValue *key, const TValue *value, uint32_t hash);
+struct TTableHashEntry *sakuraX_findHashTTable(struct SakuraTTable *table, const TValue *key, uint32_t hash);
 void sakuraX_resizeTTable(struct SakuraTTable *table, ull newCapacity);
+void sakuraX_resizeArrayTTable(struct SakuraTTable *table, ull newCapacity);
+void sakuraX_shrinkArrayTTable(struct SakuraTTable *table, ull newCapacity);
+void sakuraX_updateLengthTTable(struct SakuraTTable *table);
+void sakuraX_rehashTTable(struct SakuraTTable *table, const TValue *newKey);
 void sakuraX_setTTable(struct SakuraTTable *table, const TValue *key, const TValue *value);
 TValue sakuraX_getTTable(struct SakuraTTable *table, const TValue *key);
 void sakuraX_freeTTable(struct SakuraTTable *table);
\ No newline at end of file
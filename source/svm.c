@@ -7,233 +7,680 @@
 
 #include "disasm.h"
 
-#define REGISTER_BINOP(name, operation)                                                                                \
-    TValue val = sakuraY_pop(S);                                                                                       \
-    TValue val2 = sakuraY_pop(S);                                                                                      \
-    if (val.tt == SAKURA_TNUMFLT) {                                                                                    \
-        if (val2.tt == SAKURA_TNUMFLT) {                                                                               \
-            double a = val2.value.n;                                                                                   \
-            double b = val.value.n;                                                                                    \
-            sakuraY_push(S, sakuraY_makeTNumber(operation));                                                           \
+// instruction dispatch, threaded (labels-as-values) on compilers that support it and a plain switch otherwise.
+// define SAKURA_NO_COMPUTED_GOTO at build time to force the switch.
+#if defined(__GNUC__) && !defined(SAKURA_NO_COMPUTED_GOTO)
+#define SAKURA_COMPUTED_GOTO
+#endif
+
+// handlers read their operands from a, b, c and bx, see assembler.h for the encoding
+#define VM_DECODE()                                                                                                    \
+    a = SAKURA_GET_A(ins);                                                                                             \
+    b = SAKURA_GET_B(ins);                                                                                             \
+    c = SAKURA_GET_C(ins);                                                                                             \
+    bx = SAKURA_GET_BX(ins)
+
+// threaded handlers unpack their own operands, so the fields an instruction doesn't use are never computed. a wide
+// instruction already has its operands and enters its handler past the unpacking, through VM_WIDE in sjumptab.h
+#ifdef SAKURA_COMPUTED_GOTO
+#define VM_FETCH() ins = instructions[i]
+#define VM_DISPATCH(op) goto *dispatchTable[op];
+#define VM_CASE(op)                                                                                                    \
+    L_##op:                                                                                                            \
+    VM_DECODE();                                                                                                       \
+    W_##op:
+#define VM_DEFAULT L_DEFAULT:
+#define VM_BREAK                                                                                                       \
+    i++;                                                                                                               \
+    VM_FETCH();                                                                                                        \
+    goto *dispatchTable[SAKURA_GET_OP(ins)]
+
+// every handler ends in the same fetch and jump now that instructions are one word, gcc would merge them all into a
+// single indirect jump and undo the threading
+#if !defined(__clang__)
+#define VM_ATTRIBUTES __attribute__((optimize("no-crossjumping")))
+#endif
+#else
+#define VM_FETCH()                                                                                                     \
+    ins = instructions[i];                                                                                             \
+    VM_DECODE()
+#define VM_DISPATCH(op) switch (op)
+#define VM_CASE(op) case op:
+#define VM_DEFAULT default:
+#define VM_WIDE(op) goto vmdispatch
+#define VM_BREAK break
+#endif
+
+#ifndef VM_ATTRIBUTES
+#define VM_ATTRIBUTES
+#endif
+
+// registers of the current frame and constants of the running assembly, negative operands index the constant pool
+#define R(x) (frame[(x)])
+#define K(x) (constants[-(x)-1])
+#define RK(x) ((x) < 0 ? K(x) : R(x))
+
+// switch the interpreter over to the frame described by assembly and base
+#define VM_LOADFRAME()                                                                                                 \
+    frameSize = assembly->highestRegister + 1;                                                                         \
+    S->stackIndex = base + frameSize;                                                                                  \
+    frame = &S->stack[base];                                                                                           \
+    constants = assembly->pool->constants;                                                                             \
+    instructions = assembly->instructions
+
+// arithmetic follows lua 5.3, two integers give an integer and a float on either side turns both into floats. quickInt
+// and quickFlt rewrite the instruction for the kind of operation that ran
+#define NUMBER_ARITH(intOperation, operation, quickInt, quickFlt)                                                      \
+    if (TV_BOTHINT(*val2, *val)) {                                                                                     \
+        long long x = TV_INT(*val2);                                                                                   \
+        long long y = TV_INT(*val);                                                                                    \
+        long long result = intOperation;                                                                               \
+        TV_SETINT(R(a), result);                                                                                       \
+        quickInt;                                                                                                      \
+    } else {                                                                                                           \
+        double x = TV_TOFLT(*val2);                                                                                    \
+        double y = TV_TOFLT(*val);                                                                                     \
+        R(a) = sakuraY_makeTNumber(operation);                                                                         \
+        quickFlt;                                                                                                      \
+    }
+
+// operations that always work on floats, whatever the subtype of the operands
+#define FLOAT_ARITH(operation, quickened)                                                                              \
+    double x = TV_TOFLT(*val2);                                                                                        \
+    double y = TV_TOFLT(*val);                                                                                         \
+    R(a) = sakuraY_makeTNumber(operation);                                                                             \
+    quickened
+
+#define NUMBER_OPERANDS(name, left, right, body)                                                                       \
+    TValue *val2 = left;                                                                                               \
+    TValue *val = right;                                                                                               \
+    if (TV_ISNUMBER(*val)) {                                                                                           \
+        if (TV_ISNUMBER(*val2)) {                                                                                      \
+            body;                                                                                                      \
         } else {                                                                                                       \
-            printf("Error: unknown " name " operands: %d %d\n", val.tt, val2.tt);                                      \
+            printf("Error: unknown " name " operands: %d %d\n", TV_TYPE(*val), TV_TYPE(*val2));                        \
         }                                                                                                              \
     } else {                                                                                                           \
-        printf("Error: unknown " name " operands: %d\n", val.tt);                                                      \
+        printf("Error: unknown " name " operands: %d\n", TV_TYPE(*val));                                               \
+    }
+
+#define NUMBER_BINOP(name, left, right, intOperation, operation, quickInt, quickFlt)                                   \
+    NUMBER_OPERANDS(name, left, right, NUMBER_ARITH(intOperation, operation, quickInt, quickFlt))
+
+#define FLOAT_BINOP(name, left, right, operation, quickened)                                                           \
+    NUMBER_OPERANDS(name, left, right, FLOAT_ARITH(operation, quickened))
+
+// rewrite the opcode of the running instruction in place, a wide instruction keeps it in its prefix word. ins still
+// holds the word the instruction was dispatched from
+#define VM_QUICKEN(op)                                                                                                 \
+    if (SAKURA_GET_OP(ins) == SAKURA_WIDE)                                                                             \
+        instructions[i - (SAKURA_WIDE_SIZE - 1)] = (ins & ~((uint32_t)0xff << 8)) | (uint32_t)(op) << 8;               \
+    else                                                                                                               \
+        instructions[i] = (ins & ~(uint32_t)0xff) | (uint32_t)(op)
+
+// the quickened version of an operation only handles the operand types it was quickened for, anything else turns the
+// instruction back into the generic one and runs that
+#define QUICK_BINOP(both, type, get, set, left, right, operation, generic)                                             \
+    TValue *val2 = left;                                                                                               \
+    TValue *val = right;                                                                                               \
+    if (both(*val2, *val)) {                                                                                           \
+        type x = get(*val2);                                                                                           \
+        type y = get(*val);                                                                                            \
+        type result = operation;                                                                                       \
+        set(R(a), result);                                                                                             \
+        VM_BREAK;                                                                                                      \
     }                                                                                                                  \
-    i += 3;
+    VM_QUICKEN(generic);                                                                                               \
+    op = generic;                                                                                                      \
+    VM_WIDE(op)
+
+// float operations take a float and an integer too, the integer is converted
+#define VM_FLOATOPERANDS(v, w) (TV_BOTHNUMBER(v, w) & !TV_BOTHINT(v, w))
+
+#define FLOAT_QUICK(left, right, operation, generic)                                                                   \
+    QUICK_BINOP(VM_FLOATOPERANDS, double, TV_TOFLT, TV_SETNUM, left, right, operation, generic)
+#define INT_QUICK(left, right, operation, generic)                                                                     \
+    QUICK_BINOP(TV_BOTHINT, long long, TV_INT, TV_SETINT, left, right, operation, generic)
+
+// typed operations were proven by type inference to only ever see operands of their subtype, so nothing is checked
+#define TYPED_BINOP(type, get, set, left, right, operation)                                                            \
+    type x = get(left);                                                                                                \
+    type y = get(right);                                                                                               \
+    type result = operation;                                                                                           \
+    set(R(a), result)
 
-int sakuraX_interpretA(SakuraState *S, struct SakuraAssembly *assembly, int offset) {
-    int *instructions;
-    int preStackIdx;
+// numbers add, anything added to a string is concatenated
+#define ADD_VALUES(left, right, quickInt, quickFlt)                                                                    \
+    TValue *val2 = left;                                                                                               \
+    TValue *val = right;                                                                                               \
+    struct s_str v, lhs, rhs;                                                                                          \
+    if (TV_ISNUMBER(*val)) {                                                                                           \
+        if (TV_ISNUMBER(*val2)) {                                                                                      \
+            NUMBER_ARITH(TV_INTARITH(x, +, y), x + y, quickInt, quickFlt);                                             \
+        } else if (TV_TYPE(*val2) == SAKURA_TSTR) {                                                                    \
+            lhs = sakuraY_viewString(TV_STR(*val2));                                                                   \
+            v = TV_ISINT(*val) ? s_str_concat_i(&lhs, TV_INT(*val)) : s_str_concat_d(&lhs, TV_NUM(*val));              \
+            R(a) = sakuraY_makeTString(&v);                                                                            \
+            s_str_free(&v);                                                                                            \
+        } else {                                                                                                       \
+            printf("Error: unknown addition operands\n");                                                              \
+        }                                                                                                              \
+    } else if (TV_TYPE(*val) == SAKURA_TSTR) {                                                                         \
+        if (TV_ISNUMBER(*val2)) {                                                                                      \
+            rhs = sakuraY_viewString(TV_STR(*val));                                                                    \
+            v = TV_ISINT(*val2) ? s_str_concat_ii(TV_INT(*val2), &rhs) : s_str_concat_dd(TV_NUM(*val2), &rhs);         \
+            R(a) = sakuraY_makeTString(&v);                                                                            \
+            s_str_free(&v);                                                                                            \
+        } else if (TV_TYPE(*val2) == SAKURA_TSTR) {                                                                    \
+            lhs = sakuraY_viewString(TV_STR(*val2));                                                                   \
+            rhs = sakuraY_viewString(TV_STR(*val));                                                                    \
+            v = s_str_concat(&lhs, &rhs);                                                                              \
+            R(a) = sakuraY_makeTString(&v);                                                                            \
+            s_str_free(&v);                                                                                            \
+        } else {                                                                                                       \
+            printf("Error: unknown addition operands\n");                                                              \
+        }                                                                                                              \
+    } else {                                                                                                           \
+        printf("Error: what the frick is this\ntry again.\n");                                                         \
+    }
+
+// order comparison of two numbers, integers are compared as integers and mixed operands as floats. success runs
+// once holds is set
+#define NUMBER_COMPARE(name, left, right, comparison, success)                                                         \
+    if (TV_BOTHINT(left, right)) {                                                                                     \
+        long long x = TV_INT(left);                                                                                    \
+        long long y = TV_INT(right);                                                                                   \
+        holds = comparison;                                                                                            \
+        success;                                                                                                       \
+    } else if (TV_ISNUMBER(right)) {                                                                                   \
+        if (TV_ISNUMBER(left)) {                                                                                       \
+            double x = TV_TOFLT(left);                                                                                 \
+            double y = TV_TOFLT(right);                                                                                \
+            holds = comparison;                                                                                        \
+            success;                                                                                                   \
+        } else {                                                                                                       \
+            printf("Error: unknown " name " operands: %d %d\n", TV_TYPE(right), TV_TYPE(left));                        \
+        }                                                                                                              \
+    } else {                                                                                                           \
+        printf("Error: unknown " name " operands: %d\n", TV_TYPE(right));                                              \
+    }
+
+// compare-and-branch superinstructions are always followed by a jmp, which is skipped when the comparison holds and
+// taken otherwise. the operands are registers or constants
+#define VM_COMPARE_JUMP(holds)                                                                                         \
+    if (holds)                                                                                                         \
+        i += SAKURA_GET_OP(instructions[i + 1]) == SAKURA_WIDE ? SAKURA_WIDE_SIZE : 1;                                 \
+    else if (SAKURA_GET_OP(instructions[i + 1]) == SAKURA_WIDE)                                                        \
+        i = instructions[i + 3] - 1;                                                                                   \
+    else                                                                                                               \
+        i = SAKURA_GET_BX(instructions[i + 1]) - 1
+
+#define NUMBER_COMPARE_JUMP(name, comparison)                                                                          \
+    TValue left = RK(b);                                                                                               \
+    TValue right = RK(c);                                                                                              \
+    int holds = 0;                                                                                                     \
+    NUMBER_COMPARE(name, left, right, comparison, (void)0);                                                            \
+    VM_COMPARE_JUMP(holds)
+
+VM_ATTRIBUTES int sakuraX_interpretA(SakuraState *S, struct SakuraAssembly *assembly, int base) {
+    uint32_t *instructions, ins;
+    TValue *frame, *constants;
+    int op, a = 0, b = 0, c = 0, bx = 0;
+    int frameSize, results = 0;
+    // frames above this depth belong to this call, returning at this depth goes back to C
+    size_t entryDepth = S->callStackIndex;
+    ull i;
+
+#ifdef SAKURA_COMPUTED_GOTO
+#include "sjumptab.h"
+#endif
 
     LOG_CALL();
 
     S->currentState = SAKURA_FLAG_RUNTIME;
 
-    sakuraY_mergePools(S, &assembly->pool);
-
-    if (offset > 0) {
-        // int argcA = sakuraY_peek(S)->value.n;
-        // printf("interpretA called with %d args\n", argcA);
-        // sakuraDEBUG_dumpStack(S);
+    // reserve the register window of the frame, nothing is pushed or popped while the frame runs
+    frameSize = assembly->highestRegister + 1;
+    if (base + frameSize >= SAKURA_STACK_SIZE) {
+        printf("Error: stack overflow\n");
+        exit(1);
     }
 
-    preStackIdx = S->stackIndex;
-    instructions = assembly->instructions;
-    for (ull i = 0; i < assembly->size; i++) {
-        switch (instructions[i]) {
-        case SAKURA_LOADK:
-            // ignore the first argument (store reg) as it is NOT needed
-            sakuraY_push(S, assembly->pool.constants[-instructions[i + 2] - 1]);
-            i += 2;
-            break;
-        case SAKURA_SETGLOBAL:
-            // ignore the first argument (store reg) as it is NOT needed
-            sakura_setGlobal(S, &assembly->pool.constants[-instructions[i + 2] - 1].value.s);
-            i += 2;
-            break;
-        case SAKURA_GETGLOBAL:
-            // ignore the first argument (store reg) as it is NOT needed
-            // printf("function %p pushed\n", S->globals.pairs[instructions[i + 2]].value.value.cfn);
-            sakuraY_push(S, S->globals.pairs[instructions[i + 2]].value);
-            i += 2;
-            break;
-        case SAKURA_CLOSURE:
-            // ignore the first argument (store reg) as it is NOT needed
-            sakuraY_push(S, sakuraY_makeTFunc(assembly->closures[instructions[i + 2]]));
-            i += 2;
-            break;
-        case SAKURA_MOVE:
-            S->stack[instructions[i + 1]] = S->stack[instructions[i + 2]];
-            if (instructions[i + 1] == S->stackIndex)
-                S->stackIndex++;
-            i += 2;
-            break;
-        case SAKURA_ADD: {
-            TValue val = sakuraY_pop(S);
-            TValue val2 = sakuraY_pop(S);
-            if (val.tt == SAKURA_TNUMFLT) {
-                if (val2.tt == SAKURA_TNUMFLT) {
-                    sakuraY_push(S, sakuraY_makeTNumber(val2.value.n + val.value.n));
-                } else if (val2.tt == SAKURA_TSTR) {
-                    struct s_str v = s_str_concat_d(&val2.value.s, val.value.n);
-                    sakuraY_push(S, sakuraY_makeTString(&v));
-                    s_str_free(&v);
-                } else {
-                    printf("Error: unknown addition operands\n");
-                }
-            } else if (val.tt == SAKURA_TSTR) {
-                if (val2.tt == SAKURA_TNUMFLT) {
-                    struct s_str v = s_str_concat_dd(val2.value.n, &val.value.s);
-                    sakuraY_push(S, sakuraY_makeTString(&v));
-                    s_str_free(&v);
-                } else if (val2.tt == SAKURA_TSTR) {
-                    struct s_str v = s_str_concat(&val2.value.s, &val.value.s);
-                    sakuraY_push(S, sakuraY_makeTString(&v));
-                    s_str_free(&v);
-                } else {
-                    printf("Error: unknown addition operands\n");
-                }
+    VM_LOADFRAME();
+    // every assembly ends in a RETURN, so the threaded handlers never run off the end of the instructions
+    for (i = 0; i < assembly->size; i++) {
+    vmfetch:
+        VM_FETCH();
+        op = SAKURA_GET_OP(ins);
+#ifndef SAKURA_COMPUTED_GOTO
+    vmdispatch:
+#endif
+        VM_DISPATCH(op) {
+        VM_CASE(SAKURA_LOADK)
+            R(a) = K(bx);
+            VM_BREAK;
+        VM_CASE(SAKURA_LOADNIL)
+            for (int range = 0; range <= b; range++)
+                R(a + range) = sakuraY_makeTNil();
+            VM_BREAK;
+        VM_CASE(SAKURA_SETGLOBAL)
+            S->globals.pairs[bx].value = R(a);
+            VM_BREAK;
+        VM_CASE(SAKURA_GETGLOBAL)
+            R(a) = S->globals.pairs[bx].value;
+            VM_BREAK;
+        VM_CASE(SAKURA_CLOSURE)
+            R(a) = sakuraY_makeTFunc(assembly->closures[bx]);
+            VM_BREAK;
+        VM_CASE(SAKURA_MOVE)
+            R(a) = R(b);
+            VM_BREAK;
+        VM_CASE(SAKURA_ADD) {
+            ADD_VALUES(&R(b), &R(c), VM_QUICKEN(SAKURA_ADDI), VM_QUICKEN(SAKURA_ADDN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_ADDK) {
+            ADD_VALUES(&R(b), &K(c), VM_QUICKEN(SAKURA_ADDKI), VM_QUICKEN(SAKURA_ADDKN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_SUB) {
+            NUMBER_BINOP("subtraction", &R(b), &R(c), TV_INTARITH(x, -, y), x - y, VM_QUICKEN(SAKURA_SUBI),
+                         VM_QUICKEN(SAKURA_SUBN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_SUBK) {
+            NUMBER_BINOP("subtraction", &R(b), &K(c), TV_INTARITH(x, -, y), x - y, VM_QUICKEN(SAKURA_SUBKI),
+                         VM_QUICKEN(SAKURA_SUBKN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_MUL) {
+            NUMBER_BINOP("multiplication", &R(b), &R(c), TV_INTARITH(x, *, y), x * y, VM_QUICKEN(SAKURA_MULI),
+                         VM_QUICKEN(SAKURA_MULN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_MULK) {
+            NUMBER_BINOP("multiplication", &R(b), &K(c), TV_INTARITH(x, *, y), x * y, VM_QUICKEN(SAKURA_MULKI),
+                         VM_QUICKEN(SAKURA_MULKN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_DIV) {
+            FLOAT_BINOP("division", &R(b), &R(c), x / y, VM_QUICKEN(SAKURA_DIVN));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_ADDN) {
+            FLOAT_QUICK(&R(b), &R(c), x + y, SAKURA_ADD);
+        }
+        VM_CASE(SAKURA_SUBN) {
+            FLOAT_QUICK(&R(b), &R(c), x - y, SAKURA_SUB);
+        }
+        VM_CASE(SAKURA_MULN) {
+            FLOAT_QUICK(&R(b), &R(c), x * y, SAKURA_MUL);
+        }
+        VM_CASE(SAKURA_DIVN) {
+            QUICK_BINOP(TV_BOTHNUMBER, double, TV_TOFLT, TV_SETNUM, &R(b), &R(c), x / y, SAKURA_DIV);
+        }
+        VM_CASE(SAKURA_ADDKN) {
+            FLOAT_QUICK(&R(b), &K(c), x + y, SAKURA_ADDK);
+        }
+        VM_CASE(SAKURA_SUBKN) {
+            FLOAT_QUICK(&R(b), &K(c), x - y, SAKURA_SUBK);
+        }
+        VM_CASE(SAKURA_MULKN) {
+            FLOAT_QUICK(&R(b), &K(c), x * y, SAKURA_MULK);
+        }
+        VM_CASE(SAKURA_ADDI) {
+            INT_QUICK(&R(b), &R(c), TV_INTARITH(x, +, y), SAKURA_ADD);
+        }
+        VM_CASE(SAKURA_SUBI) {
+            INT_QUICK(&R(b), &R(c), TV_INTARITH(x, -, y), SAKURA_SUB);
+        }
+        VM_CASE(SAKURA_MULI) {
+            INT_QUICK(&R(b), &R(c), TV_INTARITH(x, *, y), SAKURA_MUL);
+        }
+        VM_CASE(SAKURA_ADDKI) {
+            INT_QUICK(&R(b), &K(c), TV_INTARITH(x, +, y), SAKURA_ADDK);
+        }
+        VM_CASE(SAKURA_SUBKI) {
+            INT_QUICK(&R(b), &K(c), TV_INTARITH(x, -, y), SAKURA_SUBK);
+        }
+        VM_CASE(SAKURA_MULKI) {
+            INT_QUICK(&R(b), &K(c), TV_INTARITH(x, *, y), SAKURA_MULK);
+        }
+        VM_CASE(SAKURA_TADDI) {
+            TYPED_BINOP(long long, TV_INT, TV_SETINT, R(b), R(c), TV_INTARITH(x, +, y));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TSUBI) {
+            TYPED_BINOP(long long, TV_INT, TV_SETINT, R(b), R(c), TV_INTARITH(x, -, y));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TMULI) {
+            TYPED_BINOP(long long, TV_INT, TV_SETINT, R(b), R(c), TV_INTARITH(x, *, y));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TADDKI) {
+            TYPED_BINOP(long long, TV_INT, TV_SETINT, R(b), K(c), TV_INTARITH(x, +, y));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TSUBKI) {
+            TYPED_BINOP(long long, TV_INT, TV_SETINT, R(b), K(c), TV_INTARITH(x, -, y));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TMULKI) {
+            TYPED_BINOP(long long, TV_INT, TV_SETINT, R(b), K(c), TV_INTARITH(x, *, y));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TADDF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), R(c), x + y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TSUBF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), R(c), x - y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TMULF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), R(c), x * y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TDIVF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), R(c), x / y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TADDKF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), K(c), x + y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TSUBKF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), K(c), x - y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TMULKF) {
+            TYPED_BINOP(double, TV_NUM, TV_SETNUM, R(b), K(c), x * y);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_MOD) {
+            if (TV_BOTHINT(R(b), R(c)) && TV_INT(R(c)) == 0) {
+                printf("Error: integer modulo by zero\n");
+            } else {
+                NUMBER_BINOP("modulo", &R(b), &R(c), sakuraX_modInteger(x, y), sakuraX_modFloat(x, y), (void)0, (void)0);
+            }
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_POW) {
+            FLOAT_BINOP("power", &R(b), &R(c), pow(x, y), (void)0);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_UNM) {
+            TValue *val = &R(b);
+            if (TV_ISINT(*val)) {
+                long long result = TV_INTARITH(0, -, TV_INT(*val));
+                TV_SETINT(R(a), result);
+            } else if (TV_TYPE(*val) == SAKURA_TNUMFLT) {
+                R(a) = sakuraY_makeTNumber(-TV_NUM(*val));
             } else {
-                printf("Error: what the frick is this\ntry again.\n");
+                printf("Error: unknown negation operand: %d\n", TV_TYPE(*val));
             }
-            i += 3;
-            break;
+            VM_BREAK;
         }
-        case SAKURA_MUL: {
-            REGISTER_BINOP("multiplication", a * b);
-            break;
+        VM_CASE(SAKURA_LT) {
+            TValue left = R(b);
+            TValue right = R(c);
+            int holds;
+            NUMBER_COMPARE("less-than", left, right, x < y, R(a) = sakuraY_makeTInteger(holds));
+            VM_BREAK;
         }
-        case SAKURA_DIV: {
-            REGISTER_BINOP("division", a / b);
-            break;
+        VM_CASE(SAKURA_LE) {
+            TValue left = R(b);
+            TValue right = R(c);
+            int holds;
+            NUMBER_COMPARE("less-than-or-equal-to", left, right, x <= y, R(a) = sakuraY_makeTInteger(holds));
+            VM_BREAK;
         }
-        case SAKURA_MOD: {
-            REGISTER_BINOP("modulo", fmod(a, b));
-            break;
+        VM_CASE(SAKURA_EQ) {
+            int equal = sakuraX_compareTValues(&R(b), &R(c));
+            R(a) = sakuraY_makeTInteger(equal);
+            VM_BREAK;
         }
-        case SAKURA_POW: {
-            REGISTER_BINOP("power", pow(a, b));
-            break;
+        VM_CASE(SAKURA_NE) {
+            int equal = sakuraX_compareTValues(&R(b), &R(c));
+            R(a) = sakuraY_makeTInteger(!equal);
+            VM_BREAK;
         }
-        case SAKURA_LT: {
-            REGISTER_BINOP("less-than", a < b ? 1 : 0);
-            break;
+        VM_CASE(SAKURA_LTJMP) {
+            NUMBER_COMPARE_JUMP("less-than", x < y);
+            VM_BREAK;
         }
-        case SAKURA_LE: {
-            REGISTER_BINOP("less-than-or-equal-to", a <= b ? 1 : 0);
-            break;
+        VM_CASE(SAKURA_LEJMP) {
+            NUMBER_COMPARE_JUMP("less-than-or-equal-to", x <= y);
+            VM_BREAK;
         }
-        case SAKURA_EQ: {
-            REGISTER_BINOP("equal-to", a == b ? 1 : 0);
-            break;
+        VM_CASE(SAKURA_TLTJMPI) {
+            VM_COMPARE_JUMP(TV_INT(RK(b)) < TV_INT(RK(c)));
+            VM_BREAK;
         }
-        case SAKURA_CALL: {
-            int stackIdx, ret;
+        VM_CASE(SAKURA_TLEJMPI) {
+            VM_COMPARE_JUMP(TV_INT(RK(b)) <= TV_INT(RK(c)));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TLTJMPF) {
+            VM_COMPARE_JUMP(TV_NUM(RK(b)) < TV_NUM(RK(c)));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TLEJMPF) {
+            VM_COMPARE_JUMP(TV_NUM(RK(b)) <= TV_NUM(RK(c)));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_EQJMP) {
+            TValue left = RK(b);
+            TValue right = RK(c);
+            VM_COMPARE_JUMP(sakuraX_compareTValues(&left, &right));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_NEJMP) {
+            TValue left = RK(b);
+            TValue right = RK(c);
+            VM_COMPARE_JUMP(!sakuraX_compareTValues(&left, &right));
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_NOT) {
+            TValue *val = &R(b);
+            int falsy = TV_TYPE(*val) == SAKURA_TNIL || (TV_ISINT(*val) && TV_INT(*val) == 0) ||
+                        (TV_TYPE(*val) == SAKURA_TNUMFLT && TV_NUM(*val) == 0);
+            R(a) = sakuraY_makeTInteger(falsy);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_TAILCALL) {
+            TValue *fn = &R(a);
+
+            // a frame entered straight from C has no function register below it to take over, so those calls nest
+            if (TV_TYPE(*fn) == SAKURA_TFUNC && S->callStackIndex > entryDepth) {
+                struct SakuraAssembly *callee = TV_FUNC(*fn);
+                int argc = b;
 
-            int fnLoc = instructions[i + 1] + offset + S->internalOffset;
-            int argc = instructions[i + 2];
+                if (base + (int)callee->highestRegister + 1 >= SAKURA_STACK_SIZE) {
+                    printf("Error: stack overflow\n");
+                    exit(1);
+                }
+
+                // slide the function and its arguments down over the current frame, the caller's frame is untouched
+                for (int range = 0; range <= argc; range++)
+                    frame[range - 1] = R(a + range);
+
+                for (int arg = argc; arg < (int)callee->parameters; arg++)
+                    R(arg) = sakuraY_makeTNil();
+
+                assembly = callee;
+                VM_LOADFRAME();
+                i = 0;
+                goto vmfetch;
+            }
+
+            // anything else is called normally and the RETURN after it passes the result on
+            goto vmcall;
+        }
+        VM_CASE(SAKURA_CALLGLOBAL)
+            R(a) = S->globals.pairs[c].value;
+            goto vmcall;
+        VM_CASE(SAKURA_CALL)
+        vmcall: {
+            int fnLoc = base + a;
+            int argc = b;
             TValue *fn = &S->stack[fnLoc];
-            if (fn->tt == SAKURA_TCFUNC) {
-                stackIdx = S->stackIndex;
-                sakuraY_push(S, sakuraY_makeTNumber(argc));
-                ret = fn->value.cfn(S);
+            int ret;
 
-                if (stackIdx - S->stackIndex + ret != argc) {
+            if (TV_TYPE(*fn) == SAKURA_TCFUNC) {
+                // C functions take their arguments off the top of the stack, followed by the argument count
+                S->stackIndex = fnLoc + 1 + argc;
+                sakuraY_push(S, sakuraY_makeTInteger(argc));
+                ret = TV_CFN(*fn)(S);
+
+                if (S->stackIndex - ret != fnLoc + 1) {
                     printf("Warning: C function did not pop all arguments off the stack (%d removed, %d expected)\n",
-                           stackIdx - S->stackIndex, argc);
-                } else {
-                    sakuraY_popN(S, fnLoc); // pops the function
+                           fnLoc + 1 + argc - (S->stackIndex - ret), argc);
                 }
-            } else if (fn->tt == SAKURA_TFUNC) {
-                stackIdx = S->stackIndex;
-                sakuraY_push(S, sakuraY_makeTNumber(argc));
-                ret = sakuraX_interpretA(S, fn->value.assembly, S->stackIndex);
-
-                if (stackIdx - S->stackIndex + ret != argc) {
-                    printf(
-                        "Warning: Sakura function did not pop all arguments off the stack (%d removed, %d expected)\n",
-                        stackIdx - S->stackIndex, argc);
-                } else {
-                    TValue val = sakuraY_popN(S, fnLoc); // pops the function
-                    sakuraY_attemptFreeTValue(&val);
+
+                // the first result replaces the function
+                *fn = ret > 0 ? S->stack[S->stackIndex - ret] : sakuraY_makeTNil();
+            } else if (TV_TYPE(*fn) == SAKURA_TFUNC) {
+                struct SakuraAssembly *callee = TV_FUNC(*fn);
+
+                // the arguments already are the first registers of the callee, missing ones are nil
+                if (fnLoc + 1 + (int)callee->highestRegister + 1 >= SAKURA_STACK_SIZE) {
+                    printf("Error: stack overflow\n");
+                    exit(1);
                 }
-            }
-            i += 2;
-            break;
-        }
-        case SAKURA_JMP: {
-            i = instructions[i + 1] - 1;
-            break;
-        }
-        case SAKURA_JMPIF: {
-            TValue val = sakuraY_pop(S);
-            if (val.tt == SAKURA_TNUMFLT) {
-                if (val.value.n == 0) {
-                    i = instructions[i + 1] - 1;
-                } else {
-                    i += 2;
+
+                for (int arg = argc; arg < (int)callee->parameters; arg++)
+                    S->stack[fnLoc + 1 + arg] = sakuraY_makeTNil();
+
+                if (S->callStackIndex >= S->callStackSize) {
+                    S->callStackSize *= 2;
+                    S->callStack = (struct SakuraCallFrame *)realloc(S->callStack,
+                                                                     S->callStackSize * sizeof(struct SakuraCallFrame));
                 }
+
+                // suspend the caller and continue in the callee, RETURN picks the caller back up
+                S->callStack[S->callStackIndex].assembly = assembly;
+                S->callStack[S->callStackIndex].base = base;
+                S->callStack[S->callStackIndex].pc = i;
+                S->callStackIndex++;
+
+                assembly = callee;
+                base = fnLoc + 1;
+                VM_LOADFRAME();
+                i = 0;
+                goto vmfetch;
             } else {
-                printf("Error: unknown jump-if operand\n");
+                printf("Error: attempted to call a non-function value (%d)\n", TV_TYPE(*fn));
             }
-            break;
-        }
-        case SAKURA_NEWTABLE: {
-            TValue val = sakuraY_makeTTable();
-            sakuraY_push(S, val);
-            i += 2;
-            break;
-        }
-        case SAKURA_SETTABLE: {
-            int tblLocation = instructions[i + 1];
-            int val1 = instructions[i + 2];
-            int val2 = instructions[i + 3];
-
-            TValue valA, valB;
-            if (val1 < 0) {
-                valA = assembly->pool.constants[-val1 - 1];
+
+            S->stackIndex = base + frameSize;
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_JMP) {
+            i = bx - 1;
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_JMPIF) {
+            TValue *val = &R(a);
+            if (TV_ISINT(*val)) {
+                if (TV_INT(*val) == 0)
+                    i = bx - 1;
+            } else if (TV_TYPE(*val) == SAKURA_TNUMFLT) {
+                if (TV_NUM(*val) == 0)
+                    i = bx - 1;
             } else {
-                valA = sakuraY_pop(S);
+                printf("Error: unknown jump-if operand\n");
             }
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_NEWTABLE) {
+            R(a) = sakuraY_makeTTable(bx);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_GETTABLE) {
+            TValue *tbl = &R(b);
+            TValue key = RK(c);
 
-            if (val2 < 0) {
-                valB = assembly->pool.constants[-val2 - 1];
+            if (TV_TYPE(*tbl) != SAKURA_TTABLE) {
+                printf("Error: attempted to index a non-table value (%d)\n", TV_TYPE(*tbl));
+                exit(1);
+            }
+
+            // an integer key inside the array part is read straight from it
+            if (TV_ISINT(key) && (ull)TV_INT(key) < TV_TABLE(*tbl)->arrayCapacity)
+                R(a) = TV_TABLE(*tbl)->arrayPart[TV_INT(key)];
+            else
+                R(a) = sakuraX_getTTable(TV_TABLE(*tbl), &key);
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_LENTBL) {
+            TValue *val = &R(b);
+            if (TV_TYPE(*val) == SAKURA_TTABLE) {
+                R(a) = sakuraY_makeTInteger((long long)TV_TABLE(*val)->length);
+            } else if (TV_TYPE(*val) == SAKURA_TSTR) {
+                R(a) = sakuraY_makeTInteger(TV_STR(*val)->len);
             } else {
-                valB = sakuraY_pop(S);
+                printf("Error: attempted to get the length of a non-table value (%d)\n", TV_TYPE(*val));
+                exit(1);
             }
+            VM_BREAK;
+        }
+        VM_CASE(SAKURA_SETTABLE) {
+            TValue *tbl = &R(a);
+            TValue key = RK(b);
+            TValue val = RK(c);
 
-            if (S->stack[tblLocation].tt != SAKURA_TTABLE) {
+            if (TV_TYPE(*tbl) != SAKURA_TTABLE) {
                 printf("Error: attempted to set table value on non-table\n");
                 exit(1);
             }
 
-            sakuraX_setTTable(S->stack[tblLocation].value.table, &valA, &valB);
-            i += 3;
-            break;
+            sakuraX_setTTable(TV_TABLE(*tbl), &key, &val);
+            VM_BREAK;
         }
-        case SAKURA_RETURN: {
-            if (offset > 0) {
-                for (int range = 0; range < S->stackIndex - preStackIdx; range++) {
-                    sakuraY_pop(S);
-                }
-            }
-            i += 2;
-            break;
+        VM_CASE(SAKURA_RETURN) {
+            // return b values starting at register a, they are moved to the bottom of the frame for the caller
+            results = b;
+            for (int range = 0; range < results; range++)
+                R(range) = R(a + range);
+
+            if (S->callStackIndex == entryDepth)
+                goto vmend;
+
+            // the function sits in the register right below the callee frame, the first result replaces it
+            frame[-1] = results > 0 ? R(0) : sakuraY_makeTNil();
+
+            S->callStackIndex--;
+            assembly = S->callStack[S->callStackIndex].assembly;
+            base = S->callStack[S->callStackIndex].base;
+            i = S->callStack[S->callStackIndex].pc;
+            VM_LOADFRAME();
+            VM_BREAK;
         }
-        default:
-            printf("Error: unknown/unimplemented runtime instruction '%d' @ %lld\n", instructions[i], i);
-            break;
+        VM_CASE(SAKURA_WIDE) {
+            // the real opcode is in a, its operands follow as full words
+            op = a;
+            a = (int)instructions[i + 1];
+            b = (int)instructions[i + 2];
+            c = (int)instructions[i + 3];
+            bx = b;
+            i += SAKURA_WIDE_SIZE - 1;
+            VM_WIDE(op);
+        }
+        VM_DEFAULT
+            printf("Error: unknown/unimplemented runtime instruction '%d' @ %lld\n", SAKURA_GET_OP(instructions[i]), i);
+            VM_BREAK;
         }
     }
 
-    if (offset > 0) {
-        sakuraY_pop(S); // pop argc off of the stack
-    }
+vmend:
+    S->stackIndex = base + results;
 
     LOG_POP();
-    return 0;
+    return results;
 }
 
-int sakuraX_interpret(SakuraState *S, struct SakuraAssembly *assembly) { return sakuraX_interpretA(S, assembly, 0); }
\ No newline at end of file
+int sakuraX_interpret(SakuraState *S, struct SakuraAssembly *assembly) {
+    return sakuraX_interpretA(S, assembly, S->stackIndex);
+}
@@ -3,5 +3,5 @@
 #include "assembler.h"
 #include "stable.h"
 
-int sakuraX_interpretA(SakuraState *S, struct SakuraAssembly *assembly, int offset);
+int sakuraX_interpretA(SakuraState *S, struct SakuraAssembly *assembly, int base);
 int sakuraX_interpret(SakuraState *S, struct SakuraAssembly *assembly);
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "typeinfer.h"
+
+#include <stdlib.h>
+
+void sakuraX_inferTypes(struct SakuraPeephole *P) {
+    struct SakuraTypeInfer T;
+    unsigned char *types;
+    ull blocks = 0, hits = 0, start;
+    int changed;
+
+    LOG_CALL();
+
+    T.peephole = P;
+    T.registers = P->assembly->highestRegister + 1;
+    T.block = (ull *)calloc(P->count + 1, sizeof(ull));
+    sakuraX_inferBlocks(&T);
+
+    for (ull k = 0; k < P->count; k++)
+        if (T.block[k] != 0)
+            T.block[k] = ++blocks;
+
+    T.entry = (unsigned char *)malloc((blocks + 1) * T.registers);
+    T.reached = (char *)calloc(blocks + 1, sizeof(char));
+    T.dirty = (char *)calloc(blocks + 1, sizeof(char));
+    types = (unsigned char *)malloc(T.registers);
+
+    // nothing is known about the parameters and whatever else is in the frame when the function starts
+    start = sakuraX_peepholeResolve(P, 0);
+    memset(types, SAKURA_TYPE_ANY, T.registers);
+    sakuraX_inferMerge(&T, start, types);
+
+    do {
+        changed = 0;
+        for (ull k = 0; k < P->count; k++) {
+            if (T.block[k] == 0 || !T.dirty[T.block[k] - 1])
+                continue;
+
+            T.dirty[T.block[k] - 1] = 0;
+            memcpy(types, &T.entry[(T.block[k] - 1) * T.registers], T.registers);
+            sakuraX_inferWalk(&T, k, types, 0);
+            changed = 1;
+        }
+    } while (changed);
+
+    // the types settled, every reached block is walked once more to rewrite it. blocks never reached are dead code
+    for (ull k = 0; k < P->count; k++) {
+        if (T.block[k] == 0 || !T.reached[T.block[k] - 1])
+            continue;
+
+        memcpy(types, &T.entry[(T.block[k] - 1) * T.registers], T.registers);
+        hits += sakuraX_inferWalk(&T, k, types, 1);
+    }
+
+    P->assembly->peepholeHits[SAKURA_PEEPHOLE_TYPED] += hits;
+
+    free(T.block);
+    free(T.entry);
+    free(T.reached);
+    free(T.dirty);
+    free(types);
+
+    LOG_POP();
+}
+
+// blocks start at the first instruction, at jump targets and after every branch. the fallthrough of a
+// compare-and-branch is its jmp, the block starts after that where the comparison holding skips to
+void sakuraX_inferBlocks(struct SakuraTypeInfer *T) {
+    const struct SakuraPeephole *P = T->peephole;
+
+    T->block[sakuraX_peepholeResolve(P, 0)] = 1;
+    for (ull k = 0; k < P->count; k++) {
+        if (P->removed[k])
+            continue;
+
+        if (P->code[k].op == SAKURA_JMP || P->code[k].op == SAKURA_JMPIF)
+            T->block[sakuraX_peepholeResolve(P, (ull)P->code[k].bx)] = 1;
+        if (P->code[k].op == SAKURA_JMPIF)
+            T->block[sakuraX_peepholeResolve(P, k + 1)] = 1;
+        if (sakuraX_peepholeCompareJump(P->code[k].op))
+            T->block[sakuraX_peepholeResolve(P, sakuraX_peepholeResolve(P, k + 1) + 1)] = 1;
+    }
+
+    // a jump to the end of the code doesn't start anything
+    T->block[P->count] = 0;
+}
+
+// join the types reaching the block starting at k into its entry types
+void sakuraX_inferMerge(struct SakuraTypeInfer *T, ull k, const unsigned char *types) {
+    unsigned char *entry;
+    ull b;
+
+    if (k >= T->peephole->count)
+        return;
+
+    b = T->block[k] - 1;
+    entry = &T->entry[b * T->registers];
+
+    if (!T->reached[b]) {
+        memcpy(entry, types, T->registers);
+        T->reached[b] = 1;
+        T->dirty[b] = 1;
+        return;
+    }
+
+    for (ull r = 0; r < T->registers; r++) {
+        if ((entry[r] | types[r]) != entry[r]) {
+            entry[r] |= types[r];
+            T->dirty[b] = 1;
+        }
+    }
+}
+
+// step through the block starting at k, handing the types on to every block it goes to. with rewrite set the
+// instructions are rewritten for the types they run with, and the number of rewrites is returned
+ull sakuraX_inferWalk(struct SakuraTypeInfer *T, ull k, unsigned char *types, int rewrite) {
+    const struct SakuraPeephole *P = T->peephole;
+    struct SakuraInstruction ins;
+    ull hits = 0, start = k;
+
+    for (; k < P->count; k++) {
+        if (P->removed[k])
+            continue;
+
+        if (k != start && T->block[k] != 0) {
+            sakuraX_inferMerge(T, k, types);
+            return hits;
+        }
+
+        // the step follows the original instruction, a typed one does the same to the types
+        ins = P->code[k];
+        if (rewrite)
+            hits += (ull)sakuraX_inferRewrite(T, &P->code[k], types);
+        sakuraX_inferStep(T, &ins, types);
+
+        switch (ins.op) {
+        case SAKURA_JMP:
+            sakuraX_inferMerge(T, sakuraX_peepholeResolve(P, (ull)ins.bx), types);
+            return hits;
+        case SAKURA_JMPIF:
+            sakuraX_inferMerge(T, sakuraX_peepholeResolve(P, (ull)ins.bx), types);
+            break;
+        case SAKURA_LTJMP:
+        case SAKURA_LEJMP:
+        case SAKURA_EQJMP:
+        case SAKURA_NEJMP:
+            sakuraX_inferMerge(T, sakuraX_peepholeResolve(P, sakuraX_peepholeResolve(P, k + 1) + 1), types);
+            break;
+        case SAKURA_RETURN:
+            return hits;
+        }
+    }
+
+    return hits;
+}
+
+int sakuraX_inferConstant(const struct SakuraTypeInfer *T, int rk) {
+    const TValue *constant = &T->peephole->assembly->pool->constants[-rk - 1];
+
+    if (TV_ISINT(*constant))
+        return SAKURA_TYPE_INT;
+    if (TV_TYPE(*constant) == SAKURA_TNUMFLT)
+        return SAKURA_TYPE_FLT;
+    return SAKURA_TYPE_OTHER;
+}
+
+// type of a register or constant operand, registers outside of the frame could hold anything
+int sakuraX_inferOperand(const struct SakuraTypeInfer *T, const unsigned char *types, int rk) {
+    if (rk < 0)
+        return sakuraX_inferConstant(T, rk);
+    if ((ull)rk >= T->registers)
+        return SAKURA_TYPE_ANY;
+    return types[rk];
+}
+
+// add, sub and mul give an integer for two integers and a float when either side is one. anything that isn't a
+// number is concatenated or fails and leaves the register as it was, so the result could be anything
+int sakuraX_inferArith(int left, int right) {
+    if ((left | right) & SAKURA_TYPE_OTHER)
+        return SAKURA_TYPE_ANY;
+    return (left & right & SAKURA_TYPE_INT ? SAKURA_TYPE_INTRESULT : 0) |
+           ((left | right) & SAKURA_TYPE_FLT ? SAKURA_TYPE_FLT : 0);
+}
+
+void sakuraX_inferSet(const struct SakuraTypeInfer *T, unsigned char *types, int reg, int type) {
+    if (reg >= 0 && (ull)reg < T->registers)
+        types[reg] = (unsigned char)type;
+}
+
+// the types after ins runs with the registers holding types
+void sakuraX_inferStep(const struct SakuraTypeInfer *T, const struct SakuraInstruction *ins, unsigned char *types) {
+    int left = SAKURA_TYPE_ANY, right = SAKURA_TYPE_ANY, numbers;
+
+    if (!sakuraX_opHasBx(ins->op)) {
+        left = sakuraX_inferOperand(T, types, ins->b);
+        right = sakuraX_inferOperand(T, types, ins->c);
+    }
+    numbers = !((left | right) & SAKURA_TYPE_OTHER);
+
+    switch (ins->op) {
+    case SAKURA_MOVE:
+        sakuraX_inferSet(T, types, ins->a, left);
+        break;
+    case SAKURA_LOADK:
+        sakuraX_inferSet(T, types, ins->a, sakuraX_inferConstant(T, ins->bx));
+        break;
+    case SAKURA_LOADNIL:
+        for (int reg = ins->a; reg <= ins->a + ins->b; reg++)
+            sakuraX_inferSet(T, types, reg, SAKURA_TYPE_OTHER);
+        break;
+    case SAKURA_CLOSURE:
+    case SAKURA_NEWTABLE:
+        sakuraX_inferSet(T, types, ins->a, SAKURA_TYPE_OTHER);
+        break;
+    case SAKURA_GETGLOBAL:
+    case SAKURA_GETTABLE:
+        sakuraX_inferSet(T, types, ins->a, SAKURA_TYPE_ANY);
+        break;
+    case SAKURA_ADD:
+    case SAKURA_SUB:
+    case SAKURA_MUL:
+        sakuraX_inferSet(T, types, ins->a, sakuraX_inferArith(left, right));
+        break;
+    case SAKURA_ADDK:
+    case SAKURA_SUBK:
+    case SAKURA_MULK:
+        sakuraX_inferSet(T, types, ins->a, sakuraX_inferArith(left, sakuraX_inferConstant(T, ins->c)));
+        break;
+    case SAKURA_DIV:
+    case SAKURA_POW:
+        sakuraX_inferSet(T, types, ins->a, numbers ? SAKURA_TYPE_FLT : SAKURA_TYPE_ANY);
+        break;
+    case SAKURA_MOD:
+        // an integer modulo by zero fails and leaves the register as it was
+        if (!numbers)
+            sakuraX_inferSet(T, types, ins->a, SAKURA_TYPE_ANY);
+        else if (left & right & SAKURA_TYPE_INT)
+            sakuraX_inferSet(T, types, ins->a,
+                             SAKURA_TYPE_INT | ((left | right) & SAKURA_TYPE_FLT) |
+                                 sakuraX_inferOperand(T, types, ins->a));
+        else
+            sakuraX_inferSet(T, types, ins->a, SAKURA_TYPE_FLT);
+        break;
+    case SAKURA_UNM:
+        if (left & SAKURA_TYPE_OTHER)
+            sakuraX_inferSet(T, types, ins->a, SAKURA_TYPE_ANY);
+        else
+            sakuraX_inferSet(T, types, ins->a,
+                             (left & SAKURA_TYPE_INT ? SAKURA_TYPE_INTRESULT : 0) | (left & SAKURA_TYPE_FLT));
+        break;
+    case SAKURA_LT:
+    case SAKURA_LE:
+        sakuraX_inferSet(T, types, ins->a, numbers ? SAKURA_TYPE_INT : SAKURA_TYPE_ANY);
+        break;
+    case SAKURA_EQ:
+    case SAKURA_NE:
+    case SAKURA_NOT:
+    case SAKURA_LENTBL:
+        sakuraX_inferSet(T, types, ins->a, SAKURA_TYPE_INT);
+        break;
+    case SAKURA_CALL:
+    case SAKURA_CALLGLOBAL:
+    case SAKURA_TAILCALL:
+        // the callee's frame starts at the function, everything from there up is overwritten
+        for (ull reg = (ull)ins->a; reg < T->registers; reg++)
+            types[reg] = SAKURA_TYPE_ANY;
+        break;
+    case SAKURA_SETGLOBAL:
+    case SAKURA_SETTABLE:
+    case SAKURA_JMP:
+    case SAKURA_JMPIF:
+    case SAKURA_RETURN:
+    case SAKURA_LTJMP:
+    case SAKURA_LEJMP:
+    case SAKURA_EQJMP:
+    case SAKURA_NEJMP:
+        break;
+    default:
+        // opcodes the pass doesn't know about could write anything
+        memset(types, SAKURA_TYPE_ANY, T->registers);
+        break;
+    }
+}
+
+// an integer constant next to a float is converted by the operation anyway, reading it from the pool as a float
+// gives the same result
+#define INFER_FLOAT_CONSTANT(rk)                                                                                       \
+    sakuraX_pushKNumber(T->peephole->assembly, (double)TV_INT(T->peephole->assembly->pool->constants[-(rk)-1]))
+
+// rewrite ins into its typed version when the types prove the subtype of every operand, returns whether it did
+int sakuraX_inferRewrite(struct SakuraTypeInfer *T, struct SakuraInstruction *ins, const unsigned char *types) {
+    int left, right;
+
+    if (sakuraX_opHasBx(ins->op))
+        return 0;
+
+    left = sakuraX_inferOperand(T, types, ins->b);
+    right = sakuraX_inferOperand(T, types, ins->c);
+
+    switch (ins->op) {
+    case SAKURA_ADD:
+    case SAKURA_SUB:
+    case SAKURA_MUL:
+        if (left == SAKURA_TYPE_INT && right == SAKURA_TYPE_INT)
+            ins->op = ins->op == SAKURA_ADD ? SAKURA_TADDI : ins->op == SAKURA_SUB ? SAKURA_TSUBI : SAKURA_TMULI;
+        else if (left == SAKURA_TYPE_FLT && right == SAKURA_TYPE_FLT)
+            ins->op = ins->op == SAKURA_ADD ? SAKURA_TADDF : ins->op == SAKURA_SUB ? SAKURA_TSUBF : SAKURA_TMULF;
+        else
+            return 0;
+        return 1;
+    case SAKURA_DIV:
+        if (left != SAKURA_TYPE_FLT || right != SAKURA_TYPE_FLT)
+            return 0;
+        ins->op = SAKURA_TDIVF;
+        return 1;
+    case SAKURA_ADDK:
+    case SAKURA_SUBK:
+    case SAKURA_MULK:
+        if (left == SAKURA_TYPE_INT && right == SAKURA_TYPE_INT) {
+            ins->op = ins->op == SAKURA_ADDK ? SAKURA_TADDKI : ins->op == SAKURA_SUBK ? SAKURA_TSUBKI : SAKURA_TMULKI;
+            return 1;
+        }
+        if (left != SAKURA_TYPE_FLT || (right != SAKURA_TYPE_FLT && right != SAKURA_TYPE_INT))
+            return 0;
+        if (right == SAKURA_TYPE_INT)
+            ins->c = INFER_FLOAT_CONSTANT(ins->c);
+        ins->op = ins->op == SAKURA_ADDK ? SAKURA_TADDKF : ins->op == SAKURA_SUBK ? SAKURA_TSUBKF : SAKURA_TMULKF;
+        return 1;
+    case SAKURA_LTJMP:
+    case SAKURA_LEJMP:
+        if (left == SAKURA_TYPE_INT && right == SAKURA_TYPE_INT) {
+            ins->op = ins->op == SAKURA_LTJMP ? SAKURA_TLTJMPI : SAKURA_TLEJMPI;
+            return 1;
+        }
+        // a float compared with an integer constant is compared as floats
+        if (left == SAKURA_TYPE_FLT && right == SAKURA_TYPE_INT && ins->c < 0)
+            ins->c = INFER_FLOAT_CONSTANT(ins->c);
+        else if (left == SAKURA_TYPE_INT && right == SAKURA_TYPE_FLT && ins->b < 0)
+            ins->b = INFER_FLOAT_CONSTANT(ins->b);
+        else if (left != SAKURA_TYPE_FLT || right != SAKURA_TYPE_FLT)
+            return 0;
+        ins->op = ins->op == SAKURA_LTJMP ? SAKURA_TLTJMPF : SAKURA_TLEJMPF;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+#undef INFER_FLOAT_CONSTANT
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "peephole.h"
+
+// the type of a register is the set of subtypes it may hold at some point in the code, types of the paths meeting at
+// an instruction are joined by or-ing them together. an empty set is a block no path reached yet
+#define SAKURA_TYPE_INT 1
+#define SAKURA_TYPE_FLT 2
+#define SAKURA_TYPE_OTHER 4 // nil, strings, tables and functions
+#define SAKURA_TYPE_NUMBER (SAKURA_TYPE_INT | SAKURA_TYPE_FLT)
+#define SAKURA_TYPE_ANY (SAKURA_TYPE_NUMBER | SAKURA_TYPE_OTHER)
+
+// integer arithmetic stays integer, except a nan boxed result too wide for the 48 bits of the payload is a float
+#ifdef SAKURA_NAN_BOXING
+#define SAKURA_TYPE_INTRESULT SAKURA_TYPE_NUMBER
+#else
+#define SAKURA_TYPE_INTRESULT SAKURA_TYPE_INT
+#endif
+
+// type inference over the code of a peephole pass. the code is split into blocks at jump targets and the
+// instructions after a branch, the types at the start of each block are kept and the blocks are walked again until
+// none of them change. arithmetic whose operands come out as a single subtype is then rewritten into a typed opcode
+struct SakuraTypeInfer {
+    struct SakuraPeephole *peephole;
+    ull registers;
+    ull *block;           // index + 1 of the block an instruction starts, 0 for instructions inside a block
+    unsigned char *entry; // types of the registers at the start of each block, registers entries per block
+    char *reached;        // blocks some path got to
+    char *dirty;          // blocks whose entry types changed since they were last walked
+};
+
+void sakuraX_inferTypes(struct SakuraPeephole *P);
+void sakuraX_inferBlocks(struct SakuraTypeInfer *T);
+void sakuraX_inferMerge(struct SakuraTypeInfer *T, ull k, const unsigned char *types);
+ull sakuraX_inferWalk(struct SakuraTypeInfer *T, ull k, unsigned char *types, int rewrite);
+
+int sakuraX_inferConstant(const struct SakuraTypeInfer *T, int rk);
+int sakuraX_inferOperand(const struct SakuraTypeInfer *T, const unsigned char *types, int rk);
+int sakuraX_inferArith(int left, int right);
+void sakuraX_inferSet(const struct SakuraTypeInfer *T, unsigned char *types, int reg, int type);
+void sakuraX_inferStep(const struct SakuraTypeInfer *T, const struct SakuraInstruction *ins, unsigned char *types);
+int sakuraX_inferRewrite(struct SakuraTypeInfer *T, struct SakuraInstruction *ins, const unsigned char *types);
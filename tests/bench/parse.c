@@ -0,0 +1,116 @@
+// lexer/parser benchmark. generates sources from 1 KB up to 100 MB (or up to the size in MB given as the first
+// argument), parses each one and reports the time per byte, which should stay flat as the size grows. the parser
+// pulls tokens from the lexer as it goes, so the two are timed together. a second run parses one operator-heavy
+// expression over and over, which is dominated by the expression parser and the per-compilation setup. the last run
+// compiles a short chunk the way loadstring does, through the ast and through the single-pass compiler.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "compiler.h"
+#include "parser.h"
+#include "sap.h"
+
+static const char *const benchTemplate = "fn f(a, b) {\n"
+                                         "    let c = a * b + 12\n"
+                                         "    if c > 10 { print(\"big\", c) } else { print(c - 1) }\n"
+                                         "    return c\n"
+                                         "}\n";
+
+static const char *const exprTemplate = "let x = a + b * c - d / e % f ^ g < h == i > j && k != l || (m + 1) * -n\n";
+
+static const char *const chunkTemplate = "let t = {1, 2, 3} return print(t[0] + t[1] * 2 - 1, clock() > 0)";
+
+#define EXPR_ITERATIONS 200000
+#define CHUNK_ITERATIONS 200000
+
+static double benchNow(void) { return (double)clock() / CLOCKS_PER_SEC; }
+
+int main(int argc, char **argv) {
+    size_t maxSize = (argc > 1 ? (size_t)atol(argv[1]) : 100) * 1024 * 1024;
+    size_t templateLen = strlen(benchTemplate);
+    SakuraState *S = sakura_createState();
+
+    printf("%12s %10s %10s %12s\n", "bytes", "tokens", "parse (s)", "ns/byte");
+
+    for (size_t size = 1024; size <= maxSize; size *= 10) {
+        struct s_str source;
+        struct TokenStack *tokens;
+        size_t tokenCount;
+        double start, parsed;
+
+        // whole copies of the template so the source always parses
+        source.len = (int)(size / templateLen * templateLen);
+        source.str = (char *)malloc(source.len);
+        for (int i = 0; i < source.len; i += (int)templateLen)
+            memcpy(source.str + i, benchTemplate, templateLen);
+
+        start = benchNow();
+        tokens = sakuraY_analyze(S, &source);
+        sakuraY_parse(S, tokens);
+        parsed = benchNow();
+        tokenCount = tokens->lexed;
+        sakuraX_freeTokStack(tokens);
+
+        printf("%12d %10zu %10.4f %12.2f\n", source.len, tokenCount, parsed - start,
+               (parsed - start) * 1e9 / source.len);
+
+        sakuraX_resetNodeArena(&S->nodeArena);
+        free(source.str);
+    }
+
+    {
+        struct s_str source;
+        struct TokenStack *tokens;
+        double start, parsed;
+
+        source.str = (char *)exprTemplate;
+        source.len = (int)strlen(exprTemplate);
+
+        start = benchNow();
+        for (int i = 0; i < EXPR_ITERATIONS; i++) {
+            tokens = sakuraY_analyze(S, &source);
+            sakuraY_parse(S, tokens);
+            sakuraX_freeTokStack(tokens);
+            sakuraX_resetNodeArena(&S->nodeArena);
+        }
+        parsed = benchNow();
+
+        printf("\n%12s %10s %12s\n", "expressions", "parse (s)", "ns/expr");
+        printf("%12d %10.4f %12.2f\n", EXPR_ITERATIONS, parsed - start, (parsed - start) * 1e9 / EXPR_ITERATIONS);
+    }
+
+    {
+        struct s_str source;
+        struct TokenStack *tokens;
+        double start, viaAst, singlePass;
+
+        source.str = (char *)chunkTemplate;
+        source.len = (int)strlen(chunkTemplate);
+
+        // the chunk calls into the standard library, the single-pass compiler needs the globals to exist
+        sakuraL_loadStdlib(S);
+
+        start = benchNow();
+        for (int i = 0; i < CHUNK_ITERATIONS; i++) {
+            tokens = sakuraY_analyze(S, &source);
+            sakuraX_freeAssembly(sakuraY_assemble(S, sakuraY_parse(S, tokens)));
+            sakuraX_freeTokStack(tokens);
+            sakuraX_resetNodeArena(&S->nodeArena);
+        }
+        viaAst = benchNow() - start;
+
+        start = benchNow();
+        for (int i = 0; i < CHUNK_ITERATIONS; i++)
+            sakuraX_freeAssembly(sakuraY_compile(S, &source));
+        singlePass = benchNow() - start;
+
+        printf("\n%12s %10s %12s\n", "chunks", "compile (s)", "ns/chunk");
+        printf("%12s %10.4f %12.2f\n", "ast", viaAst, viaAst * 1e9 / CHUNK_ITERATIONS);
+        printf("%12s %10.4f %12.2f\n", "single-pass", singlePass, singlePass * 1e9 / CHUNK_ITERATIONS);
+    }
+
+    sakura_destroyState(S);
+    return 0;
+}